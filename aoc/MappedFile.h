@@ -0,0 +1,48 @@
+#pragma once
+
+#include <fcntl.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nvl/macros/Aliases.h"
+#include "nvl/macros/Pure.h"
+
+namespace aoc {
+
+/// Read-only mapping of a whole file, so large inputs are paged in on demand rather than copied into memory.
+/// An empty or missing file maps to an empty view.
+class MappedFile {
+public:
+    explicit MappedFile(const char *path) {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void *data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<const char *>(data);
+                size_ = static_cast<U64>(info.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+    }
+
+    pure std::string_view view() const { return {data_, size_}; }
+
+private:
+    const char *data_ = nullptr;
+    U64 size_ = 0;
+};
+
+} // namespace aoc
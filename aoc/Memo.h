@@ -0,0 +1,171 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "nvl/data/List.h"
+#include "nvl/data/Maybe.h"
+#include "nvl/macros/Aliases.h"
+#include "nvl/macros/Pure.h"
+
+namespace aoc {
+
+/// Memoization table backed by a flat open-addressed array.
+/// With a capacity of 0 the table grows without bound. Otherwise, the table is fixed to the next power of two
+/// above the capacity and each key may only live within a small probe window from its home slot. When that
+/// window is full, an existing entry in it is evicted (round robin) to make room for the new one.
+template <typename K, typename V, typename Hash = std::hash<K>, typename Eq = std::equal_to<K>>
+class Memo {
+public:
+    static constexpr U64 kWays = 8;        // Probe window when bounded
+    static constexpr U64 kMinSlots = 16;
+
+    explicit Memo(const U64 capacity = 0) : capacity_(capacity) {
+        U64 n = kMinSlots;
+        while (n < capacity) { n <<= 1; }
+        slots_.resize(n);
+    }
+
+    pure nvl::Maybe<V> get(const K &key) {
+        const U64 limit = probe_limit();
+        for (U64 i = 0, s = home(key); i < limit; ++i, s = (s + 1) & mask()) {
+            const Slot &slot = slots_[s];
+            if (!slot.used)
+                break;
+            if (eq_(slot.key, key)) {
+                hits_ += 1;
+                return slot.value;
+            }
+        }
+        misses_ += 1;
+        return nvl::None;
+    }
+
+    void insert(const K &key, const V &value) { find_or_add(key, value).value = value; }
+
+    /// Returns the value for key, first inserting init if it isn't present. When bounded, this may evict another
+    /// entry. The reference is only valid until the next insertion.
+    V &get_or_add(const K &key, const V &init = V{}) { return find_or_add(key, init).value; }
+
+    /// Calls func(key, value) for each entry, in no particular order.
+    template <typename Func>
+    void for_each(Func &&func) const {
+        for (const Slot &slot : slots_) {
+            if (slot.used) { func(slot.key, slot.value); }
+        }
+    }
+
+    void clear() {
+        for (Slot &slot : slots_) { slot.used = false; }
+        size_ = 0;
+    }
+
+    pure bool bounded() const { return capacity_ > 0; }
+    pure U64 size() const { return size_; }
+    pure U64 hits() const { return hits_; }
+    pure U64 misses() const { return misses_; }
+    pure U64 evictions() const { return evictions_; }
+
+private:
+    struct Slot {
+        K key{};
+        V value{};
+        bool used = false;
+    };
+
+    Slot &find_or_add(const K &key, const V &init) {
+        if (!bounded() && (size_ + 1) * 2 > slots_.size()) {
+            grow();
+        }
+        const U64 limit = probe_limit();
+        const U64 h = home(key);
+        for (U64 i = 0, s = h; i < limit; ++i, s = (s + 1) & mask()) {
+            Slot &slot = slots_[s];
+            if (!slot.used) {
+                slot = {key, init, true};
+                size_ += 1;
+                return slot;
+            }
+            if (eq_(slot.key, key)) {
+                return slot;
+            }
+        }
+        // Only reachable when bounded: the probe window is full, so replace one of its entries.
+        Slot &slot = slots_[(h + evictions_ % kWays) & mask()];
+        slot = {key, init, true};
+        evictions_ += 1;
+        return slot;
+    }
+
+    pure U64 mask() const { return slots_.size() - 1; }
+    pure U64 probe_limit() const { return bounded() ? std::min<U64>(kWays, slots_.size()) : slots_.size(); }
+    pure U64 home(const K &key) const {
+        // std::hash is the identity for integers, so mix the bits before masking (splitmix64 finalizer).
+        U64 x = hash_(key);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return (x ^ (x >> 31)) & mask();
+    }
+
+    void grow() {
+        std::vector<Slot> prev(slots_.size() * 2);
+        std::swap(prev, slots_);
+        size_ = 0;
+        for (const Slot &slot : prev) {
+            if (slot.used) { insert(slot.key, slot.value); }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    U64 capacity_ = 0;
+    U64 size_ = 0;
+    U64 hits_ = 0;
+    U64 misses_ = 0;
+    U64 evictions_ = 0;
+    [[no_unique_address]] Hash hash_;
+    [[no_unique_address]] Eq eq_;
+};
+
+/// Evaluates a counting recurrence f(key) = sum of f(child) using an explicit stack, memoizing each interior key.
+/// `expand(key, children)` either returns the value of key directly (a base case), or appends the keys whose
+/// values sum to the value of key to `children` and returns None.
+template <typename K, typename V, typename Hash, typename Eq, typename Expand>
+V recurse(Memo<K, V, Hash, Eq> &memo, const K &root, Expand &&expand) {
+    struct Frame {
+        K key;
+        U64 base = 0;     // Index of this frame's first child result in values
+        bool expanded = false;
+    };
+    nvl::List<Frame> stack { Frame{root} };
+    nvl::List<V> values;
+    nvl::List<K> children;
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (frame.expanded) {
+            V total {};
+            for (U64 i = frame.base; i < values.size(); ++i) { total += values[i]; }
+            values.resize(frame.base);
+            values.push_back(total);
+            memo.insert(frame.key, total);
+            stack.pop_back();
+        } else if (auto cached = memo.get(frame.key)) {
+            values.push_back(*cached);
+            stack.pop_back();
+        } else if (auto value = expand(std::as_const(frame.key), children)) {
+            values.push_back(*value);
+            children.clear();
+            stack.pop_back();
+        } else {
+            frame.expanded = true;
+            frame.base = values.size();
+            for (auto iter = children.rbegin(); iter != children.rend(); ++iter) {
+                stack.push_back(Frame{*iter});
+            }
+            children.clear();
+        }
+    }
+    return values.back();
+}
+
+} // namespace aoc
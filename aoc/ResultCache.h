@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unistd.h>
+
+#include "nvl/macros/Aliases.h"
+#include "nvl/macros/Pure.h"
+
+// Identifies the solver build. Defaults to the compile time of the including file, so rebuilding a day after
+// changing it never returns answers from the previous build.
+#ifndef AOC_BUILD_ID
+#define AOC_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+namespace aoc {
+
+/// Optional on-disk cache of answers keyed by (day, input content hash, solver build ID).
+/// Disabled unless AOC_CACHE_DIR is set. With AOC_CACHE_VERIFY=1, cached answers are recomputed and compared.
+/// Answers are stored as text and must not contain whitespace.
+class ResultCache {
+public:
+    explicit ResultCache(std::string day, const std::string &input, const char *build = AOC_BUILD_ID)
+        : day_(std::move(day)) {
+        const char *dir = std::getenv("AOC_CACHE_DIR");
+        const char *verify = std::getenv("AOC_CACHE_VERIFY");
+        enabled_ = dir != nullptr && *dir != '\0';
+        verify_ = verify != nullptr && std::string(verify) == "1";
+        if (!enabled_)
+            return;
+
+        std::ifstream file(input, std::ios::binary);
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        std::ostringstream name;
+        name << day_ << '-' << std::hex << std::setfill('0') << std::setw(16) << fnv1a(contents.str()) << '-'
+             << std::setw(16) << fnv1a(build) << ".txt";
+        path_ = std::filesystem::path(dir) / name.str();
+
+        std::ifstream entry(path_);
+        U64 part = 0;
+        std::string answer;
+        while (entry >> part >> answer) {
+            answers_[part] = answer;
+        }
+    }
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    ~ResultCache() {
+        if (enabled_) {
+            std::cerr << "Cache (day " << day_ << "): " << hits_ << " hits, " << misses_ << " misses";
+            if (verify_) {
+                std::cerr << ", " << mismatches_ << " mismatches";
+            }
+            std::cerr << std::endl;
+        }
+    }
+
+    /// Returns the stored answer for the given part if there is one, otherwise calls compute() and stores it.
+    template <typename F, typename T = std::invoke_result_t<F>>
+    T get(const U64 part, F &&compute) {
+        if (enabled_ && !verify_) {
+            if (auto iter = answers_.find(part); iter != answers_.end()) {
+                T value{};
+                std::istringstream in(iter->second);
+                if (in >> value && (in >> std::ws).eof()) {
+                    hits_ += 1;
+                    return value;
+                }
+                // Unreadable entry: drop it and recompute as a miss.
+                answers_.erase(iter);
+            }
+        }
+        const T value = compute();
+        if (!enabled_)
+            return value;
+
+        std::ostringstream text;
+        text << value;
+        if (auto iter = answers_.find(part); iter != answers_.end()) {
+            hits_ += 1;
+            if (iter->second != text.str()) {
+                mismatches_ += 1;
+                std::cerr << "Cache (day " << day_ << "): part " << part << " was " << iter->second
+                          << " but recomputed as " << text.str() << std::endl;
+                answers_[part] = text.str();
+                save();
+            }
+        } else {
+            misses_ += 1;
+            answers_[part] = text.str();
+            save();
+        }
+        return value;
+    }
+
+    pure bool enabled() const { return enabled_; }
+    pure U64 hits() const { return hits_; }
+    pure U64 misses() const { return misses_; }
+    pure U64 mismatches() const { return mismatches_; }
+
+private:
+    static U64 fnv1a(const std::string &bytes) {
+        U64 h = 0xcbf29ce484222325ULL;
+        for (const char c : bytes) {
+            h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    /// Failures are reported but never thrown, since the answer being saved has already been computed.
+    void save() const {
+        // Write to a temporary unique to this process and rename so concurrent runs never observe a partial entry.
+        std::error_code error;
+        std::filesystem::create_directories(path_.parent_path(), error);
+        const std::filesystem::path temp = path_.string() + "." + std::to_string(::getpid()) + ".tmp";
+        {
+            std::ofstream out(temp);
+            for (const auto &[part, answer] : answers_) {
+                out << part << ' ' << answer << '\n';
+            }
+            if (!out.flush()) {
+                std::cerr << "Cache (day " << day_ << "): unable to write " << temp << std::endl;
+                std::filesystem::remove(temp, error);
+                return;
+            }
+        }
+        std::filesystem::rename(temp, path_, error);
+        if (error) {
+            std::cerr << "Cache (day " << day_ << "): unable to save " << path_ << ": " << error.message() << std::endl;
+            std::filesystem::remove(temp, error);
+        }
+    }
+
+    std::string day_;
+    std::filesystem::path path_;
+    std::map<U64, std::string> answers_;
+    bool enabled_ = false;
+    bool verify_ = false;
+    U64 hits_ = 0;
+    U64 misses_ = 0;
+    U64 mismatches_ = 0;
+};
+
+} // namespace aoc
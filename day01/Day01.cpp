@@ -1,14 +1,70 @@
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <regex>
 #include <string>
-#include <vector>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include "nvl/macros/Assert.h"
+
+// LSD radix sort over 8-bit digits. Each pass histograms and then scatters contiguous chunks of the input on
+// separate threads; scattering each chunk to its own precomputed offsets keeps every pass stable.
+void radix_sort(std::vector<int64_t> &vec) {
+    constexpr size_t kRadix = 256;
+    constexpr size_t kMinChunk = 1 << 16;
+    const auto key = [](int64_t x) { return static_cast<uint64_t>(x) ^ (uint64_t{1} << 63); };
+
+    const size_t n = vec.size();
+    const size_t hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t num_threads = std::clamp<size_t>(n / kMinChunk, 1, hw);
+    const size_t chunk = (n + num_threads - 1) / num_threads;
+    const auto parallel = [&](const auto &func) {
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(func, t, t * chunk, std::min(n, (t + 1) * chunk));
+        }
+        func(0, 0, std::min(n, chunk));
+        for (auto &thread : threads) { thread.join(); }
+    };
+
+    // Skip digits which are the same for every element (e.g. the upper bytes of small values).
+    uint64_t lo = UINT64_MAX, hi = 0;
+    for (int64_t x : vec) {
+        lo = std::min(lo, key(x));
+        hi = std::max(hi, key(x));
+    }
+
+    std::vector<int64_t> buffer(n);
+    std::vector<std::array<size_t, kRadix>> offsets(num_threads);
+    for (size_t shift = 0; shift < 64; shift += 8) {
+        if ((lo >> shift) == (hi >> shift))
+            break;
+        parallel([&](size_t t, size_t begin, size_t end) {
+            offsets[t].fill(0);
+            for (size_t i = begin; i < end; ++i) { offsets[t][(key(vec[i]) >> shift) & 0xFF] += 1; }
+        });
+        size_t total = 0;
+        for (size_t d = 0; d < kRadix; ++d) {
+            for (size_t t = 0; t < num_threads; ++t) {
+                const size_t count = offsets[t][d];
+                offsets[t][d] = total;
+                total += count;
+            }
+        }
+        parallel([&](size_t t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) { buffer[offsets[t][(key(vec[i]) >> shift) & 0xFF]++] = vec[i]; }
+        });
+        std::swap(vec, buffer);
+    }
+}
 
-int64_t part1(std::vector<int64_t> &a, std::vector<int64_t> &b) {
-    std::ranges::sort(a);
-    std::ranges::sort(b);
+// Expects both columns to be sorted.
+int64_t part1(const std::vector<int64_t> &a, const std::vector<int64_t> &b) {
     int64_t sum = 0;
     for (size_t i = 0; i < a.size(); ++i) {
         sum += std::abs(a[i] - b[i]);
@@ -16,14 +72,189 @@ int64_t part1(std::vector<int64_t> &a, std::vector<int64_t> &b) {
     return sum;
 }
 
-int64_t part2(std::vector<int64_t> &a, std::vector<int64_t> &b) {
-    std::unordered_map<int64_t, size_t> n;
-    for (int64_t i : b) { n[i] += 1; }
+// Expects both columns to be sorted: walks runs of equal values in both at once.
+int64_t part2(const std::vector<int64_t> &a, const std::vector<int64_t> &b) {
     int64_t sim = 0;
-    for (int64_t i : a) { sim += i * n[i]; }
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            const int64_t x = a[i];
+            int64_t na = 0, nb = 0;
+            for (; i < a.size() && a[i] == x; ++i) { ++na; }
+            for (; j < b.size() && b[j] == x; ++j) { ++nb; }
+            sim += x * na * nb;
+        }
+    }
     return sim;
 }
 
+// Maintains both answers while pairs are inserted and removed, without re-sorting.
+// Pairing the columns by rank means one insertion can re-pair every element between the two new ranks, so the
+// distance is instead tracked via sum_i |a_(i) - b_(i)| = sum_x |C_a(x) - C_b(x)|, where C_a(x) is the number of
+// elements of a which are <= x. Inserting (x, y) adds +1 to C_a - C_b on [x, y) (or -1 on [y, x)), which is applied
+// to a blocked difference array with blocks of about sqrt(max value) values, in O(sqrt(max value)). Blocks only
+// store per-value differences once an update covers part of them. A value past the current range doubles the range
+// until it fits and rebuilds the blocks from the per-value counts, which happens at most log2(max value) times.
+// The similarity is updated in O(1) from per-value counts.
+class Online {
+public:
+    explicit Online(const int64_t max_value = 0) { resize(std::max<int64_t>(max_value, kMinRange)); }
+
+    // Values must be non-negative. Pairs being removed must have been inserted before.
+    void insert(const int64_t x, const int64_t y) { update(x, y, 1); }
+    void remove(const int64_t x, const int64_t y) { update(x, y, -1); }
+
+    int64_t distance() const { return distance_; }
+    int64_t similarity() const { return similarity_; }
+
+private:
+    struct Block {
+        explicit Block(const size_t block_size)
+            : size(static_cast<int64_t>(block_size)), count{{0, size}}, nonneg(size) {}
+
+        int64_t count_of(const int64_t d) const {
+            const auto iter = count.find(d);
+            return iter == count.end() ? 0 : iter->second;
+        }
+
+        // Adds delta (+1 or -1) to the entire block in O(1).
+        void add(const int64_t delta) {
+            if (delta > 0) {
+                sum += nonneg - (size - nonneg);
+                nonneg += count_of(-1 - lazy);
+            } else {
+                const int64_t pos = nonneg - count_of(-lazy);
+                sum += (size - pos) - pos;
+                nonneg = pos;
+            }
+            lazy += delta;
+        }
+
+        // Adds delta to [begin, end) within this block in O(block size).
+        void add(const size_t begin, const size_t end, const int64_t delta) {
+            diff.resize(static_cast<size_t>(size), 0);
+            for (size_t i = 0; i < diff.size(); ++i) {
+                diff[i] += lazy + (i >= begin && i < end ? delta : 0);
+            }
+            lazy = 0;
+            recount();
+        }
+
+        // Sets every value in the block to the same difference in O(1).
+        void fill(const int64_t d) {
+            diff.clear();
+            count = {{0, size}};
+            lazy = d;
+            nonneg = d >= 0 ? size : 0;
+            sum = std::abs(d) * size;
+        }
+
+        // Recomputes the totals from diff, which must be materialized and have no pending lazy offset.
+        void recount() {
+            count.clear();
+            nonneg = 0;
+            sum = 0;
+            for (const int64_t d : diff) {
+                count[d] += 1;
+                nonneg += d >= 0;
+                sum += std::abs(d);
+            }
+        }
+
+        int64_t size;
+        std::vector<int64_t> diff;                 // C_a - C_b, excluding lazy; empty while all 0
+        std::unordered_map<int64_t, int64_t> count; // diff => number of values
+        int64_t lazy = 0;
+        int64_t nonneg;  // Number of values where diff + lazy >= 0
+        int64_t sum = 0; // Sum of |diff + lazy|
+    };
+
+    void update(const int64_t x, const int64_t y, const int64_t sign) {
+        ASSERT(x >= 0 && y >= 0, "Values must be non-negative.");
+        if (std::max(x, y) > max_value_) {
+            int64_t max_value = max_value_;
+            while (max_value < std::max(x, y)) { max_value = 2 * max_value + 1; }
+            resize(max_value);
+        }
+        if (sign > 0) {
+            similarity_ += x * cb_[x];
+            ca_[x] += 1;
+            similarity_ += y * ca_[y];
+            cb_[y] += 1;
+        } else {
+            ca_[x] -= 1;
+            similarity_ -= x * cb_[x];
+            cb_[y] -= 1;
+            similarity_ -= y * ca_[y];
+        }
+        if (x < y) {
+            add(x, y, sign);
+        } else if (y < x) {
+            add(y, x, -sign);
+        }
+    }
+
+    // Adds delta to C_a - C_b over [begin, end). Values past the last block are all 0 since |a| == |b|.
+    void add(const int64_t begin, const int64_t end, const int64_t delta) {
+        const size_t lo = static_cast<size_t>(begin);
+        const size_t hi = static_cast<size_t>(end);
+        while (blocks_.size() * block_size_ < hi) { blocks_.emplace_back(block_size_); }
+        for (size_t b = lo / block_size_; b * block_size_ < hi; ++b) {
+            Block &block = blocks_[b];
+            const size_t first = b * block_size_;
+            distance_ -= block.sum;
+            if (lo <= first && first + block_size_ <= hi) {
+                block.add(delta);
+            } else {
+                block.add(std::max(lo, first) - first, std::min(hi, first + block_size_) - first, delta);
+            }
+            distance_ += block.sum;
+        }
+    }
+
+    // Sets the range of values to [0, max_value] and rebuilds the blocks from the per-value counts. C_a - C_b only
+    // changes at values in a or b, so only blocks containing one of those need to store per-value differences.
+    void resize(const int64_t max_value) {
+        max_value_ = max_value;
+        block_size_ = static_cast<size_t>(std::sqrt(static_cast<double>(max_value))) + 1;
+        std::map<size_t, int64_t> steps; // Value => change in C_a - C_b at that value
+        for (const auto &[x, n] : ca_) { steps[static_cast<size_t>(x)] += n; }
+        for (const auto &[y, n] : cb_) { steps[static_cast<size_t>(y)] -= n; }
+        blocks_.clear();
+        distance_ = 0;
+        int64_t level = 0;
+        auto step = steps.begin();
+        for (size_t first = 0; step != steps.end(); first += block_size_) {
+            Block &block = blocks_.emplace_back(block_size_);
+            if (step->first >= first + block_size_) {
+                block.fill(level);
+            } else {
+                block.diff.resize(block_size_);
+                for (size_t i = 0; i < block_size_; ++i) {
+                    for (; step != steps.end() && step->first == first + i; ++step) { level += step->second; }
+                    block.diff[i] = level;
+                }
+                block.recount();
+            }
+            distance_ += block.sum;
+        }
+    }
+
+    static constexpr int64_t kMinRange = (1 << 20) - 1;
+
+    int64_t max_value_ = 0;
+    size_t block_size_ = 0;
+    std::vector<Block> blocks_;
+    std::unordered_map<int64_t, int64_t> ca_; // Value => count in a
+    std::unordered_map<int64_t, int64_t> cb_; // Value => count in b
+    int64_t distance_ = 0;
+    int64_t similarity_ = 0;
+};
+
 int main() {
     const std::regex regex("([0-9]+) +([0-9]+)");
 
@@ -37,8 +268,30 @@ int main() {
             b.push_back(std::stoi(match[2].str()));
         }
     }
+    radix_sort(a);
+    radix_sort(b);
     std::cout << "Part 1: " << part1(a, b) << std::endl;
     std::cout << "Part 2: " << part2(a, b) << std::endl;
 
+    // Optional live feed of updates on top of the input, one per line: "+ x y" inserts a pair, "- x y" removes one.
+    std::ifstream feed("../data/full/01-feed");
+    if (feed.is_open()) {
+        Online online(std::max(a.empty() ? 0 : a.back(), b.empty() ? 0 : b.back()));
+        for (size_t i = 0; i < a.size(); ++i) {
+            online.insert(a[i], b[i]);
+        }
+        char op;
+        int64_t x, y;
+        while (feed >> op >> x >> y) {
+            if (op == '+') {
+                online.insert(x, y);
+            } else if (op == '-') {
+                online.remove(x, y);
+            }
+            std::cout << op << " " << x << " " << y << ": " << online.distance() << ", " << online.similarity()
+                      << std::endl;
+        }
+    }
+
     return 0;
 }
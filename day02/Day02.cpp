@@ -3,6 +3,7 @@
 #include <fstream>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -19,58 +20,172 @@ std::ostream &operator<<(std::ostream &os, const std::vector<int64_t> &vec) {
     return os << "}";
 }
 
-bool is_safe_skip(const std::vector<int64_t> &report, std::optional<size_t> skip) {
-    std::optional<int64_t> prev;
-    std::optional<Dir> delta;
-    for (size_t i = 0; i < report.size(); ++i) {
-        if (!skip.has_value() || *skip != i) {
-            const int64_t curr = report[i];
-            if (prev.has_value()) {
-                const int64_t diff = curr - *prev;
-                const int64_t abs_diff = std::abs(diff);
-                const Dir direction = dir(diff);
-                if (abs_diff < 1 || abs_diff > 3)
-                    return false;
-                if (delta.has_value() && direction != *delta)
-                    return false;
-                delta = direction;
-            }
-            prev = curr;
+bool is_step(const int64_t prev, const int64_t curr, const Dir direction) {
+    const int64_t diff = curr - prev;
+    const int64_t abs_diff = std::abs(diff);
+    return abs_diff >= 1 && abs_diff <= 3 && dir(diff) == direction;
+}
+
+struct Safety {
+    bool strict = false;
+    bool dampened = false;
+};
+
+// Checks the report both as-is and with up to one level removed in O(N).
+// For each direction, the prefix [0, i] is valid iff i <= last_prefix, and the suffix [i, N) is valid iff
+// i >= first_suffix. Removing level k is then safe iff both sides of k are valid and its neighbors form a step.
+Safety is_safe(const std::vector<int64_t> &report) {
+    Safety safety;
+    const size_t n = report.size();
+    if (n <= 2) {
+        safety.strict = n < 2 || is_step(report[0], report[1], dir(report[1] - report[0]));
+        safety.dampened = true;
+        return safety;
+    }
+    for (const Dir direction : {kPos, kNeg}) {
+        size_t last_prefix = 0;
+        while (last_prefix + 1 < n && is_step(report[last_prefix], report[last_prefix + 1], direction)) {
+            last_prefix += 1;
+        }
+        size_t first_suffix = n - 1;
+        while (first_suffix > 0 && is_step(report[first_suffix - 1], report[first_suffix], direction)) {
+            first_suffix -= 1;
+        }
+        safety.strict |= (last_prefix == n - 1);
+        // Only levels in [first_suffix - 1, last_prefix + 1] have valid prefixes and suffixes on both sides.
+        const size_t begin = std::max<size_t>(first_suffix, 1) - 1;
+        const size_t end = std::min(last_prefix + 1, n - 1);
+        for (size_t k = begin; !safety.dampened && k <= end; ++k) {
+            safety.dampened = k == 0 || k == n - 1 || is_step(report[k - 1], report[k + 1], direction);
         }
     }
-    return true;
+    safety.dampened |= safety.strict;
+    return safety;
 }
 
-// This is O(N^2) but oh well
-bool is_safe(const std::vector<int64_t> &report, bool dampen = false) {
-    if (is_safe_skip(report, std::nullopt))
-        return true;
-    if (!dampen)
-        return false;
-    for (size_t i = 0; i < report.size(); ++i) {
-        if (is_safe_skip(report, i))
+// Batched check for short reports, as structure-of-arrays: lane i of levels[j] is level j of the i-th report.
+// Only reports with at most kMaxLevels levels, all in [0, 127], fit in a batch, so differences can't overflow int8.
+// Every check is a fixed sequence of lane-wise compares and masks over the whole batch, using compiler vector
+// extensions (GCC and Clang) so this lowers to SIMD without depending on a particular instruction set.
+struct Batch {
+    using I8x16 = int8_t __attribute__((vector_size(16)));
+    static constexpr size_t kLanes = 16;
+    static constexpr size_t kMaxLevels = 8;
+    static constexpr size_t kMaxPairs = kMaxLevels - 1;
+
+    // Parses the levels of a report straight into the next lane. Returns false, leaving the batch unchanged, if the
+    // report doesn't fit.
+    bool add(const std::string_view line) {
+        size_t n = 0;
+        int value = -1; // Level being parsed, or -1 between levels
+        const auto end_level = [&] {
+            if (value < 0)
+                return true;
+            if (value > 127 || n == kMaxLevels)
+                return false;
+            levels[n++][size] = static_cast<int8_t>(value);
+            value = -1;
             return true;
+        };
+        const auto discard = [&] {
+            for (size_t j = 0; j < n; ++j) { levels[j][size] = 0; }
+            return false;
+        };
+        for (const char c : line) {
+            if (c >= '0' && c <= '9') {
+                value = std::min(std::max(value, 0) * 10 + (c - '0'), 128); // Saturates past 127
+            } else if (!end_level()) {
+                return discard();
+            }
+        }
+        if (!end_level())
+            return discard();
+        lengths[size] = static_cast<int8_t>(n);
+        size += 1;
+        return true;
     }
-    return false;
+
+    bool full() const { return size == kLanes; }
+
+    // Returns the number of strictly safe and dampened safe reports in the batch.
+    std::pair<int64_t, int64_t> count() const {
+        const I8x16 none = {};
+        const I8x16 all = (none == none);
+        I8x16 strict = none;
+        I8x16 dampened = none;
+        for (const int8_t sign : {1, -1}) {
+            // Steps past the end of a report are always valid.
+            const auto is_step = [&](const I8x16 &prev, const I8x16 &curr, const I8x16 &padding) {
+                const I8x16 diff = (curr - prev) * sign;
+                return ((diff >= 1) & (diff <= 3)) | padding;
+            };
+            I8x16 prefix[kMaxPairs + 1]; // prefix[i]: pairs [0, i) are valid
+            I8x16 suffix[kMaxPairs + 2]; // suffix[i]: pairs [i, kMaxPairs) are valid
+            prefix[0] = all;
+            suffix[kMaxPairs] = suffix[kMaxPairs + 1] = all;
+            for (size_t j = 0; j < kMaxPairs; ++j) {
+                prefix[j + 1] = prefix[j] & is_step(levels[j], levels[j + 1], lengths <= static_cast<int8_t>(j + 1));
+            }
+            for (size_t j = kMaxPairs; j-- > 0;) {
+                suffix[j] = suffix[j + 1] & is_step(levels[j], levels[j + 1], lengths <= static_cast<int8_t>(j + 1));
+            }
+            strict |= prefix[kMaxPairs];
+            for (size_t k = 0; k < kMaxLevels; ++k) {
+                // Removing level k leaves pairs [0, k-1) and [k+1, kMaxPairs), joined by level k-1 to k+1.
+                const I8x16 bridge = (k == 0 || k == kMaxPairs)
+                    ? all : is_step(levels[k - 1], levels[k + 1], lengths <= static_cast<int8_t>(k + 1));
+                dampened |= prefix[k == 0 ? 0 : k - 1] & suffix[k + 1] & bridge & (lengths > static_cast<int8_t>(k));
+            }
+        }
+        int64_t num_strict = 0;
+        int64_t num_dampened = 0;
+        for (size_t i = 0; i < size; ++i) {
+            num_strict += (strict[i] != 0);
+            num_dampened += (strict[i] != 0 || dampened[i] != 0);
+        }
+        return {num_strict, num_dampened};
+    }
+
+    I8x16 levels[kMaxLevels] = {};
+    I8x16 lengths = {};
+    size_t size = 0;
+};
+
+// Parses every level of a report, for reports which don't fit in a batch.
+std::vector<int64_t> parse_report(const std::string &line) {
+    static const std::regex num("[0-9]+");
+    std::vector<int64_t> report;
+    std::smatch match;
+    std::string::const_iterator iter (line.cbegin());
+    while (std::regex_search(iter, line.cend(), match, num)) {
+        report.push_back(std::stoi(match[0].str()));
+        iter = match.suffix().first;
+    }
+    return report;
 }
 
 int main() {
-    const std::regex num("[0-9]+");
     std::ifstream file("../data/full/02");
     std::string line;
-    std::smatch match;
     int64_t part1 = 0;
     int64_t part2 = 0;
+    Batch batch;
+    const auto flush = [&] {
+        const auto [strict, dampened] = batch.count();
+        part1 += strict;
+        part2 += dampened;
+        batch = Batch();
+    };
     while (std::getline(file, line)) {
-        std::vector<int64_t> report;
-        std::string::const_iterator iter (line.cbegin());
-        while (std::regex_search(iter, line.cend(), match, num)) {
-            report.push_back(std::stoi(match[0].str()));
-            iter = match.suffix().first;
+        if (batch.add(line)) {
+            if (batch.full()) { flush(); }
+        } else {
+            const Safety safety = is_safe(parse_report(line));
+            part1 += safety.strict;
+            part2 += safety.dampened;
         }
-        part1 += is_safe(report);
-        part2 += is_safe(report, /*dampen*/true);
     }
+    flush();
     std::cout << "Part 1: " << part1 << std::endl;
     std::cout << "Part 2: " << part2 << std::endl;
 }
@@ -1,61 +1,158 @@
-#include <fstream>
+#include <algorithm>
 #include <iostream>
-#include <regex>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-struct Pattern {
-    std::regex regex;
-    std::function<void(std::smatch)> func;
+#include "aoc/MappedFile.h"
+
+// Result of scanning some span of the input without knowing whether instructions are enabled on entry.
+// Both possibilities are tracked (indexed by the entry state), so summaries of consecutive spans can be merged
+// in order with operator+, which is associative.
+struct Summary {
+    Summary operator+(const Summary &rhs) const {
+        Summary result;
+        result.part1 = part1 + rhs.part1;
+        for (const bool entry : {false, true}) {
+            result.part2[entry] = part2[entry] + rhs.part2[enabled[entry]];
+            result.enabled[entry] = rhs.enabled[enabled[entry]];
+        }
+        return result;
+    }
+
+    int64_t part1 = 0;
+    int64_t part2[2] = {0, 0};         // Sum of enabled products, given the state on entry
+    bool enabled[2] = {false, true};   // State on exit, given the state on entry
 };
-void parse(const std::string &line, const std::vector<Pattern> &patterns) {
-    std::smatch match;
-    std::string::const_iterator iter (line.cbegin());
-    while (iter != line.cend()) {
-        std::optional<long> first_idx = std::nullopt;
-        std::optional<size_t> first_pos = std::nullopt;
-        std::optional<std::smatch> first_match = std::nullopt;
-        for (size_t i = 0; i < patterns.size(); ++i) {
-            if (std::regex_search(iter, line.cend(), match, patterns[i].regex)) {
-                const auto idx = match.position();
-                if (!first_idx.has_value() || idx < *first_idx) {
-                    first_idx = idx;
-                    first_pos = i;
-                    first_match = match;
-                }
+
+// Recognizes mul(a,b), do(), and don't() in a single left-to-right pass over the bytes, so the input can be fed
+// in arbitrary chunks. None of the tokens can start inside another token's prefix other than at its first
+// character, so on a mismatch it is enough to restart from the current byte. This also means every token which
+// matches at some position is counted regardless of what precedes it, so spans can be scanned independently.
+class Scanner {
+public:
+    // Scans tokens which start in [begin, end), only reading past end to finish a token that started before it.
+    void scan(const std::string_view bytes, const size_t begin, const size_t end) {
+        for (size_t i = begin; i < bytes.size() && (i < end || state != kStart); ++i) {
+            if (!step(bytes[i])) {
+                state = kStart;
+                if (i >= end)
+                    break;
+                step(bytes[i]);
             }
         }
-        if (first_match.has_value()) {
-            auto &func = patterns.at(*first_pos).func;
-            func(*first_match);
-            iter = first_match->suffix().first;
-        } else {
-            iter = line.cend();
+    }
+    void scan(const std::string_view bytes) { scan(bytes, 0, bytes.size()); }
+
+    Summary summary;
+
+private:
+    static constexpr int kMaxDigits = 3;
+    enum State {
+        kStart,
+        kM, kMu, kMul, // mul(a,b)
+        kA, kB,        // in the first or second operand
+        kD, kDo,       // do() or don't()
+        kDoOpen,       // do(
+        kDon, kDonQ, kDont, kDontOpen
+    };
+
+    static bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+
+    // Advances on c, returning false if c can't continue the current token.
+    bool step(const char c) {
+        switch (state) {
+        case kStart:
+            state = c == 'm' ? kM : c == 'd' ? kD : kStart;
+            return true;
+        case kM: return advance(c == 'u', kMu);
+        case kMu: return advance(c == 'l', kMul);
+        case kMul:
+            a = b = 0;
+            digits = 0;
+            return advance(c == '(', kA);
+        case kA:
+            if (c == ',' && digits > 0) {
+                digits = 0;
+                state = kB;
+                return true;
+            }
+            return digit(c, a);
+        case kB:
+            if (c == ')' && digits > 0) {
+                summary.part1 += a * b;
+                for (const bool entry : {false, true}) {
+                    summary.part2[entry] += summary.enabled[entry] * a * b;
+                }
+                state = kStart;
+                return true;
+            }
+            return digit(c, b);
+        case kD: return advance(c == 'o', kDo);
+        case kDo: return c == 'n' ? advance(true, kDon) : advance(c == '(', kDoOpen);
+        case kDoOpen: return close(c, /*enable*/true);
+        case kDon: return advance(c == '\'', kDonQ);
+        case kDonQ: return advance(c == 't', kDont);
+        case kDont: return advance(c == '(', kDontOpen);
+        case kDontOpen: return close(c, /*enable*/false);
         }
+        return false;
+    }
+
+    bool advance(const bool matched, const State next) {
+        if (matched) { state = next; }
+        return matched;
+    }
+
+    bool close(const char c, const bool enable) {
+        if (c != ')')
+            return false;
+        summary.enabled[false] = summary.enabled[true] = enable;
+        state = kStart;
+        return true;
+    }
+
+    bool digit(const char c, int64_t &value) {
+        if (!is_digit(c) || digits == kMaxDigits)
+            return false;
+        value = value * 10 + (c - '0');
+        digits += 1;
+        return true;
     }
+
+    State state = kStart;
+    int64_t a = 0;
+    int64_t b = 0;
+    int digits = 0;
+};
+
+// Splits the input into one span per thread and merges the span summaries in order.
+Summary scan_parallel(const std::string_view bytes) {
+    constexpr size_t kMinChunk = 1 << 20;
+    const size_t hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t num_threads = std::clamp<size_t>(bytes.size() / kMinChunk, 1, hw);
+    const size_t chunk = (bytes.size() + num_threads - 1) / num_threads;
+    std::vector<Summary> summaries(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            Scanner scanner;
+            scanner.scan(bytes, t * chunk, std::min(bytes.size(), (t + 1) * chunk));
+            summaries[t] = scanner.summary;
+        });
+    }
+    Summary total;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads[t].join();
+        total = total + summaries[t];
+    }
+    return total;
 }
 
 int main() {
-    const std::regex mul_regex ("mul\\(([0-9]{1,3}),([0-9]{1,3})\\)");
-    const std::regex do_regex("do\\(\\)");
-    const std::regex dont_regex("don't\\(\\)");
+    const aoc::MappedFile file("../data/full/03");
+    const Summary summary = scan_parallel(file.view());
 
-    int64_t part1 = 0;
-    int64_t part2 = 0;
-    bool enabled = true;
-    std::vector<Pattern> patterns;
-    patterns.emplace_back(mul_regex, [&](const std::smatch &match) {
-        const int64_t mul = std::stoi(match[1].str()) * std::stoi(match[2].str());
-        part1 += mul;
-        part2 += enabled * mul;
-    });
-    patterns.emplace_back(do_regex, [&](const auto &){ enabled = true; });
-    patterns.emplace_back(dont_regex, [&](const auto &){ enabled = false; });
-
-    std::ifstream file("../data/full/03");
-    std::string line;
-    while (std::getline(file, line)) {
-        parse(line, patterns);
-    }
-
-    std::cout << "Part 1: " << part1 << std::endl;
-    std::cout << "Part 2: " << part2 << std::endl;
+    std::cout << "Part 1: " << summary.part1 << std::endl;
+    std::cout << "Part 2: " << summary.part2[/*enabled on entry*/true] << std::endl;
 }
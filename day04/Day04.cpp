@@ -1,66 +1,268 @@
+#include <array>
+#include <bit>
+#include <cstring>
 #include <fstream>
+#include <queue>
+#include <string>
+#include <vector>
 
 #include "nvl/data/Tensor.h"
-#include "nvl/data/Set.h"
-
-constexpr nvl::Pos<2> directions[8] {
-    {-1, -1},
-    {-1, 0},
-    {-1, 1},
-    {0, -1},
-    {0, 1},
-    {1, -1},
-    {1, 0},
-    {1, 1}
+#include "nvl/geo/Tuple.h"
+#include "nvl/macros/Aliases.h"
+
+// Byte compares over 16 cells at a time, using compiler vector extensions (GCC and Clang).
+using I8x16 = int8_t __attribute__((vector_size(16)));
+constexpr U64 kLanes = sizeof(I8x16);
+
+I8x16 load(const char *ptr) {
+    I8x16 v;
+    std::memcpy(&v, ptr, sizeof(v));
+    return v;
+}
+
+// Number of set lanes in a compare result (each lane is either 0x00 or 0xFF).
+U64 count(const I8x16 &mask) {
+    U64 words[2];
+    std::memcpy(words, &mask, sizeof(words));
+    return (std::popcount(words[0]) + std::popcount(words[1])) / 8;
+}
+
+// Row-major copy of the grid with a border of '.' around it. The right border is kLanes wide, so vector loads at
+// an offset of -1, 0, or +1 from any cell stay in bounds and never reach into the next row.
+struct Grid {
+    explicit Grid(const nvl::Tensor<2,char> &tensor)
+        : rows(tensor.shape()[0]), cols(tensor.shape()[1]), stride(cols + 1 + kLanes),
+          cells((rows + 2) * stride, '.') {
+        for (const nvl::Pos<2> idx : tensor.indices()) {
+            (*this)(idx[0], idx[1]) = tensor[idx];
+        }
+    }
+    char &operator()(const I64 i, const I64 j) { return cells[(i + 1) * stride + j + 1]; }
+    const char *row(const I64 i) const { return &cells[(i + 1) * stride + 1]; }
+
+    I64 rows;
+    I64 cols;
+    I64 stride;
+    std::vector<char> cells;
 };
 
-int64_t part1(const nvl::Tensor<2,char> &tensor) {
-    const std::string pattern = "XMAS";
-    int64_t n = 0;
-    for (nvl::Pos<2> idx : tensor.indices()) {
-        for (auto delta : directions) {
-            bool match = true;
-            for (size_t d = 0; match && d < pattern.size(); ++d) {
-                match = tensor.get_or(idx + (delta * d), '.') == pattern[d];
+constexpr U64 kPadding = kLanes + 3; // Room for loads of a 4 letter word from the last kLanes positions
+
+// Gathers every line of the grid along (di, dj), each followed by a '.' separator: the rows, the transpose, or
+// one of the two skewed (diagonal) copies. Words along the line can then be found with contiguous compares.
+std::vector<char> lines(const Grid &grid, const I64 di, const I64 dj) {
+    std::vector<char> bytes;
+    // Every cell once, one separator per line (at most rows + cols lines), and the padding.
+    bytes.reserve(grid.rows * grid.cols + grid.rows + grid.cols + kPadding);
+    const auto in_bounds = [&](const I64 i, const I64 j) {
+        return i >= 0 && i < grid.rows && j >= 0 && j < grid.cols;
+    };
+    for (I64 i = 0; i < grid.rows; ++i) {
+        for (I64 j = 0; j < grid.cols; ++j) {
+            if (!in_bounds(i - di, j - dj)) {
+                for (I64 y = i, x = j; in_bounds(y, x); y += di, x += dj) {
+                    bytes.push_back(grid.row(y)[x]);
+                }
+                bytes.push_back('.');
             }
-            n += match;
         }
     }
+    bytes.resize(bytes.size() + kPadding, '.');
+    return bytes;
+}
+
+// Counts occurrences of the 4 letter word in bytes, kLanes starting positions at a time.
+U64 count_word(const std::vector<char> &bytes, const char *word) {
+    U64 n = 0;
+    for (U64 i = 0; i < bytes.size() - kPadding; i += kLanes) {
+        const char *p = &bytes[i];
+        n += count((load(p) == word[0]) & (load(p + 1) == word[1]) & (load(p + 2) == word[2]) &
+                   (load(p + 3) == word[3]));
+    }
     return n;
 }
 
-struct Cross {
-    static nvl::Set<char> get(const nvl::Tensor<2,char> &tensor, const nvl::Pos<2> &idx, const nvl::List<nvl::Pos<2>> &deltas) {
-        nvl::Set<char> result;
-        for (auto d : deltas)
-            result.insert(tensor.get_or(idx + d, '.'));
-        return result;
+int64_t part1(const Grid &grid) {
+    U64 n = 0;
+    for (const auto &[di, dj] : {std::pair{0, 1}, {1, 0}, {1, 1}, {1, -1}}) {
+        const std::vector<char> bytes = lines(grid, di, dj);
+        n += count_word(bytes, "XMAS") + count_word(bytes, "SAMX");
     }
+    return static_cast<int64_t>(n);
+}
 
-    explicit Cross(const nvl::Tensor<2,char> &tensor, const nvl::Pos<2> &idx) {
-        static const nvl::Set<char> kMatch = {'M', 'S'};
-        static const nvl::List<nvl::Pos<2>> l0 = {{-1, -1}, {1, 1}};
-        static const nvl::List<nvl::Pos<2>> l1 = {{-1, 1}, {1, -1}};
-        if (tensor[idx] != 'A')
-            return;
-        const auto s0 = get(tensor, idx, l0);
-        const auto s1 = get(tensor, idx, l1);
-        matched = (s0 == kMatch && s1 == kMatch);
+int64_t part2(const Grid &grid) {
+    const auto is_ms = [](const I8x16 &a, const I8x16 &b) {
+        return ((a == 'M') & (b == 'S')) | ((a == 'S') & (b == 'M'));
+    };
+    U64 n = 0;
+    for (I64 i = 0; i < grid.rows; ++i) {
+        const char *up = grid.row(i - 1);
+        const char *mid = grid.row(i);
+        const char *down = grid.row(i + 1);
+        for (I64 j = 0; j < grid.cols; j += kLanes) {
+            const I8x16 cross = (load(mid + j) == 'A') & is_ms(load(up + j - 1), load(down + j + 1)) &
+                                is_ms(load(up + j + 1), load(down + j - 1));
+            n += count(cross);
+        }
     }
-    explicit operator bool() const { return matched; }
-    bool matched = false;
+    return static_cast<int64_t>(n);
+}
+
+// Aho-Corasick automaton over a list of words. The goto function is fully expanded into a dense table over only
+// the letters which appear in the words; every other byte maps to letter 0, which always returns to the root.
+class Automaton {
+public:
+    explicit Automaton(const std::vector<std::string> &words) {
+        letter_.fill(0);
+        for (const std::string &word : words) {
+            for (const char c : word) {
+                U32 &letter = letter_[static_cast<unsigned char>(c)];
+                letter = letter ? letter : ++num_letters_;
+            }
+        }
+        add_node();
+        duplicate_.resize(words.size(), kNone);
+        for (U32 id = 0; id < words.size(); ++id) {
+            if (words[id].empty())
+                continue;
+            U32 node = 0;
+            for (const char c : words[id]) {
+                if (!edge(node, c)) {
+                    const U32 child = add_node(); // Invalidates references into table_
+                    edge(node, c) = child;
+                }
+                node = edge(node, c);
+            }
+            if (word_[node] == kNone) {
+                word_[node] = id;
+            } else {
+                U32 last = word_[node];
+                while (duplicate_[last] != kNone) { last = duplicate_[last]; }
+                duplicate_[last] = id;
+            }
+        }
+        // Breadth-first, so the fail link of each node is final before any of its children are visited.
+        std::queue<U32> queue;
+        for (U32 letter = 1; letter <= num_letters_; ++letter) {
+            if (const U32 child = table_[letter]) { queue.push(child); }
+        }
+        while (!queue.empty()) {
+            const U32 node = queue.front();
+            queue.pop();
+            for (U32 letter = 1; letter <= num_letters_; ++letter) {
+                U32 &child = table_[node * width() + letter];
+                const U32 fallback = table_[fail_[node] * width() + letter];
+                if (child) {
+                    fail_[child] = fallback;
+                    output_[child] = word_[fallback] != kNone ? fallback : output_[fallback];
+                    queue.push(child);
+                } else {
+                    child = fallback;
+                }
+            }
+        }
+    }
+
+    U32 next(const U32 state, const char c) const {
+        return table_[state * width() + letter_[static_cast<unsigned char>(c)]];
+    }
+
+    // Calls func(word) for every word ending at the current position, given the state after consuming it.
+    template <typename Func>
+    void matches(const U32 state, Func &&func) const {
+        for (U32 node = word_[state] != kNone ? state : output_[state]; node != 0; node = output_[node]) {
+            for (U32 word = word_[node]; word != kNone; word = duplicate_[word]) {
+                func(word);
+            }
+        }
+    }
+
+private:
+    static constexpr U32 kNone = UINT32_MAX;
+
+    U32 width() const { return num_letters_ + 1; }
+    U32 &edge(const U32 node, const char c) { return table_[node * width() + letter_[static_cast<unsigned char>(c)]]; }
+    U32 add_node() {
+        table_.resize(table_.size() + width(), 0);
+        fail_.push_back(0);
+        output_.push_back(0);
+        word_.push_back(kNone);
+        return static_cast<U32>(word_.size() - 1);
+    }
+
+    std::array<U32, 256> letter_{};
+    U32 num_letters_ = 0;
+    std::vector<U32> table_;     // Goto function, indexed by node * width() + letter
+    std::vector<U32> fail_;      // Longest proper suffix which is also in the trie
+    std::vector<U32> output_;    // Longest proper suffix which is a word (0 if none)
+    std::vector<U32> word_;      // First word ending at each node, if any
+    std::vector<U32> duplicate_; // Next word with the same letters, if any
 };
 
-int64_t part2(const nvl::Tensor<2,char> &tensor) {
-    int64_t n = 0;
-    for (auto idx : tensor.indices()) {
-        n += Cross(tensor, idx).matched;
+struct WordMatch {
+    U32 word;
+    nvl::Pos<2> pos; // First letter
+    nvl::Pos<2> dir;
+};
+
+struct SearchResult {
+    std::vector<U64> counts; // Per word
+    std::vector<WordMatch> matches;
+};
+
+// Finds every word along all 8 directions by streaming each line of the grid through the automaton once, so the
+// cost is proportional to the grid size plus the number of matches rather than the number of words.
+SearchResult search(const Grid &grid, const std::vector<std::string> &words, const bool positions = true) {
+    static constexpr nvl::Pos<2> kDirections[8] {
+        {0, 1}, {1, 0}, {1, 1}, {1, -1}, {0, -1}, {-1, 0}, {-1, -1}, {-1, 1}
+    };
+    const Automaton automaton(words);
+    SearchResult result;
+    result.counts.resize(words.size(), 0);
+    const auto in_bounds = [&](const nvl::Pos<2> &p) {
+        return p[0] >= 0 && p[0] < grid.rows && p[1] >= 0 && p[1] < grid.cols;
+    };
+    for (const nvl::Pos<2> &dir : kDirections) {
+        for (I64 i = 0; i < grid.rows; ++i) {
+            for (I64 j = 0; j < grid.cols; ++j) {
+                const nvl::Pos<2> start(i, j);
+                if (in_bounds(start - dir))
+                    continue;
+                U32 state = 0;
+                for (nvl::Pos<2> p = start; in_bounds(p); p += dir) {
+                    state = automaton.next(state, grid.row(p[0])[p[1]]);
+                    automaton.matches(state, [&](const U32 word) {
+                        result.counts[word] += 1;
+                        if (positions) {
+                            const I64 length = static_cast<I64>(words[word].size());
+                            result.matches.push_back({word, p - dir * (length - 1), dir});
+                        }
+                    });
+                }
+            }
+        }
     }
-    return n;
+    return result;
 }
 
 int main() {
-    nvl::Tensor<2,char> m = nvl::matrix_from_file("../data/full/04");
-    std::cout << "Part 1: " << part1(m) << std::endl;
-    std::cout << "Part 2: " << part2(m) << std::endl;
+    const nvl::Tensor<2,char> m = nvl::matrix_from_file("../data/full/04");
+    const Grid grid(m);
+    std::cout << "Part 1: " << part1(grid) << std::endl;
+    std::cout << "Part 2: " << part2(grid) << std::endl;
+
+    // Optional dictionary to search for instead of just "XMAS", one word per line.
+    std::ifstream file("../data/full/04-words");
+    std::vector<std::string> words;
+    std::string word;
+    while (std::getline(file, word)) {
+        if (!word.empty()) { words.push_back(word); }
+    }
+    if (!words.empty()) {
+        const SearchResult result = search(grid, words, /*positions*/false);
+        for (U64 i = 0; i < words.size(); ++i) {
+            std::cout << words[i] << ": " << result.counts[i] << std::endl;
+        }
+    }
 }
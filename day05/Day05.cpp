@@ -1,26 +1,85 @@
+#include <bit>
 #include <fstream>
 #include <regex>
 
 #include "nvl/data/List.h"
-#include "nvl/data/Map.h"
 #include "nvl/data/Maybe.h"
-#include "nvl/data/Set.h"
 #include "nvl/macros/Aliases.h"
+#include "nvl/macros/Pure.h"
+#include "nvl/macros/ReturnIf.h"
 
 struct Rule {
     I64 before;
     I64 after;
 };
+/// Dense precedence table: bit (b, a) is set if page a must come before page b.
+/// Pages are assumed to be small non-negative integers. Pages without rules compare as unordered.
 struct Compare {
-    bool operator()(const I64 a, const I64 b) const {
-        static const nvl::Set<I64> kEmpty = {};
-        return rules.get_or(b, kEmpty).has(a);
+    explicit Compare(const nvl::List<Rule> &rules) {
+        for (const Rule &rule : rules) {
+            pages = std::max({pages, rule.before + 1, rule.after + 1});
+        }
+        words = (pages + 63) / 64;
+        bits.resize(pages * words, 0);
+        for (const Rule &rule : rules) {
+            bits[rule.after * words + rule.before / 64] |= U64{1} << (rule.before % 64);
+        }
+    }
+
+    pure const U64 *before(const I64 page) const { return &bits[page * words]; }
+
+    pure bool operator()(const I64 a, const I64 b) const {
+        return_if(a < 0 || b < 0 || a >= pages || b >= pages, false);
+        return (bits[b * words + a / 64] >> (a % 64)) & 1;
     }
 
-    /// Map from page => all pages that should come before it
-    nvl::Map<I64,nvl::Set<I64>> rules;
+    I64 pages = 0;
+    I64 words = 0;
+    std::vector<U64> bits;
 };
 
+/// Rank of each page in the sorted list: the popcount of (pages before it) AND (pages in the list), which is
+/// O(words) per page. Returns None if a page is past every rule or the ranks aren't a permutation, in which case the
+/// rules don't form a total order on the list. Assumes the rules never require a page to come both before and
+/// after another, in which case distinct ranks imply a total order.
+nvl::Maybe<std::vector<U64>> ranks(const std::vector<I64> &list, const Compare &compare) {
+    std::vector<U64> pages(compare.words, 0);
+    for (const I64 page : list) {
+        return_if(page < 0 || page >= compare.pages, nvl::None);
+        pages[page / 64] |= U64{1} << (page % 64);
+    }
+    const U64 k = list.size();
+    std::vector<U64> rank(k, 0);
+    std::vector<bool> seen(k, false);
+    for (U64 i = 0; i < k; ++i) {
+        const U64 *before = compare.before(list[i]);
+        for (I64 w = 0; w < compare.words; ++w) {
+            rank[i] += std::popcount(before[w] & pages[w]);
+        }
+        return_if(rank[i] >= k || seen[rank[i]], nvl::None);
+        seen[rank[i]] = true;
+    }
+    return rank;
+}
+
+/// Orders the list, returning true if it was already sorted. When the rules restricted to the list form a total
+/// order, the sorted list is placed directly by rank. Otherwise this falls back to a comparison sort.
+bool order(std::vector<I64> &list, const Compare &compare) {
+    const auto rank = ranks(list, compare);
+    if (!rank) {
+        return_if(std::ranges::is_sorted(list, compare), true);
+        std::ranges::stable_sort(list, compare);
+        return false;
+    }
+    std::vector<I64> sorted(list.size());
+    for (U64 i = 0; i < list.size(); ++i) {
+        sorted[(*rank)[i]] = list[i];
+    }
+    const bool was_sorted = (sorted == list);
+    list = std::move(sorted);
+    return was_sorted;
+}
+
 nvl::Maybe<Rule> parse_rule(const std::string &line) {
     static const std::regex pattern ("([0-9]+)\\|([0-9]+)");
     std::smatch match;
@@ -46,26 +105,46 @@ std::vector<I64> parse_list(const std::string &line) {
     return list;
 }
 
+struct Median {
+    bool sorted;
+    I64 middle;
+};
+
+/// Finds the middle page of the sorted list, and whether the list is already sorted, without sorting it.
+/// Returns None if the rules don't form a total order on the list.
+nvl::Maybe<Median> median(const std::vector<I64> &list, const Compare &compare) {
+    const auto rank = ranks(list, compare);
+    return_if(!rank, nvl::None);
+    Median result {true, -1};
+    for (U64 i = 0; i < list.size(); ++i) {
+        result.sorted &= ((*rank)[i] == i);
+        if ((*rank)[i] == list.size() / 2) { result.middle = list[i]; }
+    }
+    return result;
+}
+
 int main() {
     std::ifstream file("../data/full/05");
     std::string line;
-    Compare compare;
+    nvl::List<Rule> rules;
     nvl::List<std::vector<I64>> lists;
     while (std::getline(file, line)) {
         if (auto rule = parse_rule(line)) {
-            compare.rules[rule->after].insert(rule->before);
+            rules.push_back(*rule);
         } else if (!line.empty()) {
             lists.push_back(parse_list(line));
         }
     }
 
+    const Compare compare(rules);
     I64 part1 = 0;
     I64 part2 = 0;
     for (auto &list : lists) {
-        if (std::ranges::is_sorted(list, compare)) {
+        if (auto m = median(list, compare)) {
+            (m->sorted ? part1 : part2) += m->middle;
+        } else if (order(list, compare)) {
             part1 += list[list.size() / 2];
         } else {
-            std::ranges::stable_sort(list, compare);
             part2 += list[list.size() / 2];
         }
     }
@@ -1,11 +1,18 @@
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <numeric>
+#include <thread>
+#include <vector>
 
+#include "aoc/ResultCache.h"
+#include "nvl/data/List.h"
 #include "nvl/data/Map.h"
-#include "nvl/data/Set.h"
-#include "nvl/data/SipHash.h"
+#include "nvl/data/Maybe.h"
 #include "nvl/data/Tensor.h"
 #include "nvl/geo/Tuple.h"
 #include "nvl/macros/Pure.h"
+#include "nvl/macros/ReturnIf.h"
 
 static const nvl::Map<char, I64> kChar2Direction {{'<', 0}, {'^', 1}, {'>', 2}, {'v', 3}};
 
@@ -35,11 +42,6 @@ struct Guard {
     I64 dir;
 };
 
-template <>
-struct std::hash<Guard> {
-    pure U64 operator()(const Guard &guard) const noexcept { return nvl::sip_hash(guard); }
-};
-
 pure Guard start(const nvl::Tensor<2,char> &map) {
     for (const auto i : map.indices()) {
         if (auto iter = kChar2Direction.find(map[i]); iter != kChar2Direction.end()) {
@@ -49,45 +51,168 @@ pure Guard start(const nvl::Tensor<2,char> &map) {
     ASSERT(false, "No starting location found.");
 }
 
+/// Dense set of (cell, direction) states: 4 direction bits per cell, tagged with a generation in the upper bits.
+/// Entries from older generations read as empty, so starting a new generation clears the set in O(1).
+class Visited {
+public:
+    explicit Visited(const U64 cells) : entries_(cells, 0) {}
+
+    void clear() {
+        generation_ += 1;
+        if (generation_ == kMaxGeneration) {
+            std::ranges::fill(entries_, 0);
+            generation_ = 1;
+        }
+    }
+
+    /// Returns false if the state was already in the set.
+    bool insert(const I64 cell, const I64 dir) {
+        U32 &entry = entries_[cell];
+        const U32 tag = generation_ << 4;
+        if ((entry & ~kDirMask) != tag) { entry = tag; }
+        const U32 bit = 1u << dir;
+        return_if(entry & bit, false);
+        entry |= bit;
+        return true;
+    }
+
+private:
+    static constexpr U32 kDirMask = 0xF;
+    static constexpr U32 kMaxGeneration = 1u << 28;
+    std::vector<U32> entries_;
+    U32 generation_ = 1;
+};
+
 struct WalkResult {
-    nvl::Set<Guard> visited;
-    nvl::Set<nvl::Pos<2>> unique;
+    nvl::List<Guard> route; // Every state, in order
+    U64 unique = 0;         // Number of distinct positions
     bool loop = false;
 };
 WalkResult walk(const nvl::Tensor<2,char> &map, const Guard &start) {
+    const I64 cols = map.shape()[1];
+    const U64 cells = map.shape()[0] * cols;
+    Visited visited(cells);
+    std::vector<bool> seen(cells, false);
     Guard curr = start;
     WalkResult result;
-    while (!result.visited.has(curr) && map.has(curr.pos)) {
-        result.visited.insert(curr);
-        result.unique.insert(curr.pos);
+    while (map.has(curr.pos) && visited.insert(curr.pos[0] * cols + curr.pos[1], curr.dir)) {
+        result.route.push_back(curr);
+        result.unique += !seen[curr.pos[0] * cols + curr.pos[1]];
+        seen[curr.pos[0] * cols + curr.pos[1]] = true;
         curr = curr.move(map);
     }
     result.loop = map.has(curr.pos);
     return result;
 }
 
-I64 part2(nvl::Tensor<2, char> &map, const Guard &start, const WalkResult &part1) {
-    I64 part2 = 0;
-    // Only check positions along the original route.
-    nvl::Set<nvl::Pos<2>> candidates;
-    for (const auto &g : part1.visited) {
+/// For every cell and direction, the cell where the guard stops before it has to turn, or kExit if it walks off
+/// the map. Loop checks can then jump straight from turn to turn.
+struct JumpTable {
+    static constexpr I64 kExit = -1;
+
+    explicit JumpTable(const nvl::Tensor<2,char> &map) : rows(map.shape()[0]), cols(map.shape()[1]) {
+        blocked.resize(rows * cols, false);
+        for (const auto i : map.indices()) {
+            blocked[index(i)] = (map[i] == '#');
+        }
+        for (I64 dir = 0; dir < 4; ++dir) {
+            stop[dir].resize(rows * cols, kExit);
+            // Visit cells so that the next cell in this direction is always computed first.
+            const nvl::Pos<2> &delta = Guard::kDirections[dir];
+            const bool reverse = delta[0] > 0 || delta[1] > 0;
+            for (I64 n = 0; n < rows * cols; ++n) {
+                const I64 c = reverse ? rows * cols - 1 - n : n;
+                const nvl::Pos<2> next = pos(c) + delta;
+                if (has(next)) {
+                    stop[dir][c] = blocked[index(next)] ? c : stop[dir][index(next)];
+                }
+            }
+        }
+    }
+
+    /// Where the guard stops from c facing dir if there were an extra obstacle at extra, which only matters if
+    /// it is directly ahead of c and no further than the existing stop.
+    pure I64 stop_with(const I64 c, const I64 dir, const nvl::Pos<2> &extra) const {
+        const I64 s = stop[dir][c];
+        const nvl::Pos<2> &delta = Guard::kDirections[dir];
+        const auto steps = [&](const nvl::Pos<2> &offset) { return offset[0] * delta[0] + offset[1] * delta[1]; };
+        const nvl::Pos<2> offset = extra - pos(c);
+        const I64 k = steps(offset);
+        const I64 reach = (s == kExit) ? INT64_MAX : steps(pos(s) - pos(c));
+        return (k > 0 && offset == delta * k && k <= reach) ? index(extra - delta) : s;
+    }
+
+    /// Returns true if the guard loops with an extra obstacle, recording only the states right after each turn.
+    /// The table itself is only read, so any number of threads can check different obstacles at once.
+    bool loops(const Guard &start, const nvl::Pos<2> &extra, Visited &turns) const {
+        turns.clear();
+        I64 c = index(start.pos);
+        I64 dir = start.dir;
+        while (true) {
+            c = stop_with(c, dir, extra);
+            return_if(c == kExit, false);
+            dir = (dir + 1) % 4;
+            return_if(!turns.insert(c, dir), true);
+        }
+    }
+
+    pure bool has(const nvl::Pos<2> &p) const { return p[0] >= 0 && p[0] < rows && p[1] >= 0 && p[1] < cols; }
+    pure I64 index(const nvl::Pos<2> &p) const { return p[0] * cols + p[1]; }
+    pure nvl::Pos<2> pos(const I64 c) const { return {c / cols, c % cols}; }
+
+    I64 rows;
+    I64 cols;
+    std::vector<bool> blocked;
+    std::vector<I64> stop[4];
+};
+
+struct Candidate {
+    Guard resume;       // State just before the route first enters obstacle
+    nvl::Pos<2> obstacle;
+};
+
+I64 part2(const nvl::Tensor<2, char> &map, const WalkResult &part1,
+          const U64 num_threads = std::max(1u, std::thread::hardware_concurrency())) {
+    // Only check positions along the original route. The route up to the first time it enters a position doesn't
+    // change when that position is blocked, so each check can resume from the state just before then.
+    const JumpTable jumps(map);
+    std::vector<bool> entered(jumps.rows * jumps.cols, false);
+    std::vector<Candidate> candidates;
+    for (const Guard &g : part1.route) {
         const Guard next = g.move(map);
-        if (next.pos != g.pos && map.get_or(next.pos, '#') == '.') {
-            candidates.insert(next.pos);
+        if (next.pos != g.pos && map.get_or(next.pos, '#') == '.' && !entered[jumps.index(next.pos)]) {
+            entered[jumps.index(next.pos)] = true;
+            candidates.push_back({g, next.pos});
         }
     }
-    for (const auto &pos : candidates) {
-        map[pos] = '#';
-        part2 += walk(map, start).loop;
-        map[pos] = '.';
+    std::atomic<U64> next = 0;
+    std::vector<I64> loops(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (U64 t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            Visited turns(jumps.rows * jumps.cols); // Reused across this worker's candidates
+            I64 n = 0;
+            for (U64 i = next++; i < candidates.size(); i = next++) {
+                n += jumps.loops(candidates[i].resume, candidates[i].obstacle, turns);
+            }
+            loops[t] = n;
+        });
     }
-    return part2;
+    for (auto &thread : threads) { thread.join(); }
+    return std::accumulate(loops.begin(), loops.end(), I64{0});
 }
 
 int main() {
-    nvl::Tensor<2,char> map = nvl::matrix_from_file("../data/full/06");
+    const std::string filename = "../data/full/06";
+    aoc::ResultCache cache ("06", filename);
+    const nvl::Tensor<2,char> map = nvl::matrix_from_file(filename);
     const Guard begin = start(map);
-    const WalkResult part1 = walk(map, begin);
-    std::cout << "Part 1: " << part1.unique.size() << std::endl;
-    std::cout << "Part 2: " << part2(map, begin, part1) << std::endl;
+    // Only walk the route if one of the parts isn't cached.
+    nvl::Maybe<WalkResult> route;
+    const auto part1 = [&]() -> const WalkResult & {
+        if (!route.has_value()) { route = walk(map, begin); }
+        return *route;
+    };
+    std::cout << "Part 1: " << cache.get(1, [&]{ return part1().unique; }) << std::endl;
+    std::cout << "Part 2: " << cache.get(2, [&]{ return part2(map, part1()); }) << std::endl;
 }
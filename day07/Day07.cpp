@@ -1,36 +1,113 @@
 #include <nvl/time/Duration.h>
 
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <regex>
 
-#include "nvl/data/Counter.h"
 #include "nvl/data/List.h"
 #include "nvl/data/Maybe.h"
 #include "nvl/macros/Aliases.h"
 #include "nvl/macros/Pure.h"
+#include "nvl/macros/ReturnIf.h"
 #include "nvl/time/Clock.h"
 
-U64 num_digits(const U64 x) { return static_cast<U64>(std::ceil(std::log10(x + 1))); }
+// Operators are types with a forward function apply(a, b) = a op b, and an inverse undo(target, b) which
+// returns the a for which apply(a, b) == target, if there is one. Operators may also define absorbs(target, b)
+// when any a gives the target (e.g. multiplying by 0).
+struct Add {
+    static U64 apply(const U64 a, const U64 b) { return a + b; }
+    static nvl::Maybe<U64> undo(const U64 target, const U64 b) { return nvl::SomeIf(target - b, target >= b); }
+};
 
-struct Line {
-    static U64 op(const U64 a, const U64 b, const U64 op) {
-        switch (op) {
-        case 0: return a + b;
-        case 1: return a * b;
-        case 2: return a * static_cast<U64>(std::pow(10, num_digits(b))) + b;
-        default: UNREACHABLE;
+struct Mul {
+    static U64 apply(const U64 a, const U64 b) { return a * b; }
+    static nvl::Maybe<U64> undo(const U64 target, const U64 b) {
+        return nvl::SomeIf(b ? target / b : 0, b != 0 && target % b == 0);
+    }
+    static bool absorbs(const U64 target, const U64 b) { return b == 0 && target == 0; }
+};
+
+struct Sub {
+    static U64 apply(const U64 a, const U64 b) { return a - b; } // Only defined for a >= b
+    static nvl::Maybe<U64> undo(const U64 target, const U64 b) { return nvl::SomeIf(target + b, target + b >= b); }
+};
+
+struct Xor {
+    static U64 apply(const U64 a, const U64 b) { return a ^ b; }
+    static nvl::Maybe<U64> undo(const U64 target, const U64 b) { return target ^ b; }
+};
+
+/// Concatenation of the base kBase digits of a and b.
+template <U64 kBase>
+struct Concat {
+    static constexpr auto kPowers = [] {
+        std::array<U64, 65> powers{};
+        powers[0] = 1;
+        for (size_t i = 1; i < powers.size(); ++i) {
+            // Saturate rather than overflow, since no operand can reach those powers anyway.
+            powers[i] = powers[i - 1] > UINT64_MAX / kBase ? UINT64_MAX : powers[i - 1] * kBase;
         }
+        return powers;
+    }();
+
+    /// Smallest power of kBase greater than b, i.e. what a is multiplied by.
+    static U64 shift(const U64 b) { return *std::ranges::upper_bound(kPowers, b); }
+
+    static U64 apply(const U64 a, const U64 b) { return a * shift(b) + b; }
+    static nvl::Maybe<U64> undo(const U64 target, const U64 b) {
+        const U64 pow = shift(b);
+        return nvl::SomeIf(target / pow, target % pow == b);
     }
-    pure bool may_be_true(const U64 num_ops) const {
-        const auto counter = nvl::Counter<U64>::get(rhs.size() - 1, num_ops);
-        return counter.exists([&](const nvl::List<U64> &ops) {
-            U64 total = rhs[0];
-            for (size_t i = 0; i < ops.size(); ++i) {
-                total = op(total, rhs[i + 1], ops[i]);
-            }
-            return total == lhs;
-        });
+};
+
+template <typename... Ops>
+struct OpList {};
+
+/// Bit 0: reachable with only the base operators. Bit 1: reachable with the base and extra operators.
+static constexpr U64 kBaseOps = 1;
+static constexpr U64 kAllOps = 2;
+
+/// Backward search over a compile-time set of operators, specialized per set so the inner loop has no dispatch.
+/// Works back from the target, only undoing the last operator where its inverse exists, and answers for both the
+/// base operators and the base plus extra operators in one traversal.
+template <typename Base, typename Extra>
+struct Solver;
+
+template <typename... Base, typename... Extra>
+struct Solver<OpList<Base...>, OpList<Extra...>> {
+    static U64 reachable(const nvl::List<U64> &rhs, const U64 i, const U64 target) {
+        return_if(i == 0, target == rhs[0] ? (kBaseOps | kAllOps) : 0);
+        U64 found = 0;
+        ((found |= (found == (kBaseOps | kAllOps)) ? 0 : undo<Base>(rhs, i, target) & (kBaseOps | kAllOps)), ...);
+        ((found |= (found & kAllOps) ? 0 : undo<Extra>(rhs, i, target) & kAllOps), ...);
+        return found;
+    }
+
+    template <typename Op>
+    static U64 undo(const nvl::List<U64> &rhs, const U64 i, const U64 target) {
+        if constexpr (requires { Op::absorbs(target, rhs[i]); }) {
+            return_if(Op::absorbs(target, rhs[i]), kBaseOps | kAllOps);
+        }
+        if (auto prev = Op::undo(target, rhs[i])) {
+            return reachable(rhs, i - 1, *prev);
+        }
+        return 0;
     }
+};
+
+struct Solvable {
+    bool base = false; // With only the base operators
+    bool any = false;  // With the base and extra operators
+};
+
+struct Line {
+    template <typename Base, typename Extra>
+    pure Solvable solvable() const {
+        const U64 found = Solver<Base, Extra>::reachable(rhs, rhs.size() - 1, lhs);
+        return {.base = (found & kBaseOps) != 0, .any = (found & kAllOps) != 0};
+    }
+
     U64 lhs = 0;
     nvl::List<U64> rhs;
 };
@@ -64,8 +141,9 @@ int main() {
     U64 part2 = 0;
     while (std::getline(file, line)) {
         if (auto eq = parse_line(line)) {
-            part1 += eq->may_be_true(2) * eq->lhs;
-            part2 += eq->may_be_true(3) * eq->lhs;
+            const Solvable solvable = eq->solvable<OpList<Add, Mul>, OpList<Concat<10>>>();
+            part1 += solvable.base * eq->lhs;
+            part2 += solvable.any * eq->lhs;
         }
     }
     std::cout << "Part 1: " << part1 << std::endl;
@@ -1,8 +1,13 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <fstream>
+#include <numeric>
+#include <thread>
+#include <vector>
 
 #include "nvl/data/List.h"
 #include "nvl/data/Map.h"
-#include "nvl/data/Set.h"
 #include "nvl/data/Tensor.h"
 #include "nvl/geo/Tuple.h"
 #include "nvl/macros/Aliases.h"
@@ -17,46 +22,105 @@ nvl::Map<char, nvl::List<nvl::Pos<2>>> frequencies(const nvl::Tensor<2,char> &ma
     return freqs;
 }
 
-nvl::Set<nvl::Pos<2>> antinodes(const nvl::Tensor<2, char> &map,
-                                const nvl::Map<char, nvl::List<nvl::Pos<2>>> &frequencies,
-                                const bool resonant) {
-    nvl::Set<nvl::Pos<2>> set;
+struct Antinodes {
+    U64 part1 = 0; // Without resonance
+    U64 part2 = 0; // With resonance
+};
+
+/// Where one worker marks antinodes, either as a bitmap over the map or as a list of indices when the map is too
+/// large for every worker to have its own bitmap.
+struct Marks {
+    explicit Marks(const U64 cells, const bool is_dense) : dense(is_dense) {
+        if (dense) { bits.resize((cells + 63) / 64, 0); }
+    }
+    void mark(const U64 i) {
+        if (dense) {
+            bits[i / 64] |= U64{1} << (i % 64);
+        } else {
+            indices.push_back(i);
+        }
+    }
+    bool dense;
+    std::vector<U64> bits;
+    std::vector<U64> indices;
+};
+
+U64 count(const nvl::List<Marks> &marks) {
+    if (marks.front().dense) {
+        std::vector<U64> bits = marks.front().bits;
+        for (const Marks &m : marks) {
+            for (U64 w = 0; w < bits.size(); ++w) { bits[w] |= m.bits[w]; }
+        }
+        return std::accumulate(bits.begin(), bits.end(), U64{0}, [](U64 n, U64 w) { return n + std::popcount(w); });
+    }
+    std::vector<U64> indices;
+    for (const Marks &m : marks) {
+        indices.insert(indices.end(), m.indices.begin(), m.indices.end());
+    }
+    std::ranges::sort(indices);
+    return std::ranges::unique(indices).begin() - indices.begin();
+}
+
+/// Finds antinodes with and without resonance in one pass over every pair of antennae. Work is split into tasks
+/// of up to kRowsPerTask antennae of one frequency, each paired with every later antenna of that frequency.
+Antinodes antinodes(const nvl::Tensor<2, char> &map, const nvl::Map<char, nvl::List<nvl::Pos<2>>> &frequencies,
+                    const U64 num_threads = std::max(1u, std::thread::hardware_concurrency())) {
+    static constexpr U64 kRowsPerTask = 64;
+    static constexpr U64 kMaxDenseBits = U64{1} << 32; // Total across all workers and both parts
+    const I64 rows = map.shape()[0];
+    const I64 cols = map.shape()[1];
+    const U64 cells = rows * cols;
+    const bool dense = cells * num_threads * 2 <= kMaxDenseBits;
+
+    struct Task {
+        const nvl::List<nvl::Pos<2>> *antennae;
+        U64 begin;
+        U64 end;
+    };
+    std::vector<Task> tasks;
     for (const auto &antennae : frequencies.values()) {
-        for (U64 i = 0; i < antennae.size(); ++i) {
-            const auto &a = antennae[i];
-            for (U64 j = i + 1; j < antennae.size(); ++j) {
-                const auto &b = antennae[j];
-                const nvl::Pos<2> delta = a - b;
-                if (resonant) {
-                    nvl::Pos<2> d = a;
-                    while (map.has(d)) {
-                        set.insert(d);
-                        d += delta;
-                    }
-                    d = b;
-                    while (map.has(d)) {
-                        set.insert(d);
-                        d -= delta;
+        for (U64 i = 0; i < antennae.size(); i += kRowsPerTask) {
+            tasks.push_back({&antennae, i, std::min<U64>(i + kRowsPerTask, antennae.size())});
+        }
+    }
+
+    nvl::List<Marks> part1, part2;
+    for (U64 t = 0; t < num_threads; ++t) {
+        part1.emplace_back(cells, dense);
+        part2.emplace_back(cells, dense);
+    }
+    std::atomic<U64> next = 0;
+    std::vector<std::thread> threads;
+    for (U64 t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            const auto has = [&](const nvl::Pos<2> &p) {
+                return p[0] >= 0 && p[0] < rows && p[1] >= 0 && p[1] < cols;
+            };
+            const auto index = [&](const nvl::Pos<2> &p) { return static_cast<U64>(p[0] * cols + p[1]); };
+            for (U64 k = next++; k < tasks.size(); k = next++) {
+                const auto &antennae = *tasks[k].antennae;
+                for (U64 i = tasks[k].begin; i < tasks[k].end; ++i) {
+                    const auto &a = antennae[i];
+                    for (U64 j = i + 1; j < antennae.size(); ++j) {
+                        const auto &b = antennae[j];
+                        const nvl::Pos<2> delta = a - b;
+                        if (has(a + delta)) { part1[t].mark(index(a + delta)); }
+                        if (has(b - delta)) { part1[t].mark(index(b - delta)); }
+                        for (nvl::Pos<2> d = a; has(d); d += delta) { part2[t].mark(index(d)); }
+                        for (nvl::Pos<2> d = b; has(d); d -= delta) { part2[t].mark(index(d)); }
                     }
-                } else {
-                    const nvl::Pos<2> d0 = a + delta;
-                    const nvl::Pos<2> d1 = b - delta;
-                    if (map.has(d0))
-                        set.insert(d0);
-                    if (map.has(d1))
-                        set.insert(d1);
                 }
             }
-        }
+        });
     }
-    return set;
+    for (auto &thread : threads) { thread.join(); }
+    return {.part1 = count(part1), .part2 = count(part2)};
 }
 
 int main() {
     const nvl::Tensor<2, char> map = nvl::matrix_from_file("../data/full/08");
     const nvl::Map<char, nvl::List<nvl::Pos<2>>> f = frequencies(map);
-    const nvl::Set<nvl::Pos<2>> part1 = antinodes(map, f, /*resonant*/false);
-    const nvl::Set<nvl::Pos<2>> part2 = antinodes(map, f, /*resonant*/true);
-    std::cout << "Part 1: " << part1.size() << std::endl;
-    std::cout << "Part 2: " << part2.size() << std::endl;
+    const Antinodes result = antinodes(map, f);
+    std::cout << "Part 1: " << result.part1 << std::endl;
+    std::cout << "Part 2: " << result.part2 << std::endl;
 }
@@ -1,115 +1,140 @@
-#include <fstream>
-#include <list>
-#include <ranges>
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <queue>
+#include <string_view>
+#include <vector>
 
+#include "aoc/MappedFile.h"
 #include "nvl/data/Maybe.h"
-#include "nvl/data/List.h"
 #include "nvl/macros/Aliases.h"
-#include "nvl/macros/Assert.h"
 #include "nvl/macros/Pure.h"
+#include "nvl/macros/ReturnIf.h"
 #include "nvl/time/Clock.h"
 #include "nvl/time/Duration.h"
 
-struct Block {
-    explicit Block(const nvl::Maybe<U64> id, const U64 begin, const U64 end) : id(id), begin(begin), end(end) {}
-    pure bool is_file() const { return id.has_value(); }
-    pure bool is_free() const { return !id.has_value(); }
-    pure U64 size() const { return end - begin; }
-
-    pure U64 checksum() const {
-        return_if(!id.has_value(), 0);
-        U64 checksum = 0;
-        ASSERT(begin <= end, "Invalid block " << *id << ": [" << begin << ", " << end << ")");
-        for (U64 i = begin; i < end; ++i) {
-            checksum += *id * i;
+struct Span {
+    /// Sum of i * id over every index i in the span, as an arithmetic series.
+    pure U64 checksum(const U64 id) const { return id * (size * begin + size * (size - 1) / 2); }
+
+    U64 begin;
+    U64 size;
+};
+
+/// View over the digits of a disk map. Sizes are read directly from the digits as they're needed.
+class DiskMap {
+public:
+    explicit DiskMap(std::string_view digits) : digits_(digits) {
+        while (!digits_.empty() && (digits_.back() < '0' || digits_.back() > '9')) {
+            digits_.remove_suffix(1);
         }
-        return checksum;
     }
 
-    nvl::Maybe<U64> id;
-    U64 begin;
-    U64 end;
+    /// Number of files on the disk.
+    pure U64 files() const { return (digits_.size() + 1) / 2; }
+
+    /// Size of file i.
+    pure U64 file(const U64 i) const { return digit(2 * i); }
+
+    /// Size of the free span directly after file i.
+    pure U64 free(const U64 i) const { return 2 * i + 1 < digits_.size() ? digit(2 * i + 1) : 0; }
+
+private:
+    pure U64 digit(const U64 i) const { return static_cast<U64>(digits_[i] - '0'); }
+
+    std::string_view digits_;
 };
 
-U64 checksum(const std::list<Block> &list) {
+/// Moves blocks one at a time from the last file to the first free block. One cursor walks forward through the
+/// disk while the other takes blocks from the back, emitting the checksum of each run as it is placed.
+U64 part1(const DiskMap &disk) {
+    return_if(disk.files() == 0, 0);
     U64 checksum = 0;
-    for (const auto &block : list) {
-        checksum += block.checksum();
+    U64 pos = 0;
+    U64 back = disk.files() - 1;
+    U64 remaining = disk.file(back); // Blocks of the back file which haven't been moved yet
+    for (U64 front = 0; front <= back; ++front) {
+        const U64 size = (front == back) ? remaining : disk.file(front);
+        checksum += Span{pos, size}.checksum(front);
+        pos += size;
+        U64 free = disk.free(front);
+        while (free > 0 && back > front) {
+            const U64 move = std::min(free, remaining);
+            checksum += Span{pos, move}.checksum(back);
+            pos += move;
+            free -= move;
+            remaining -= move;
+            if (remaining == 0) {
+                back -= 1;
+                remaining = disk.file(back);
+            }
+        }
     }
     return checksum;
 }
 
-std::list<Block> do_part1(std::list<Block> list) {
-    nvl::Maybe<U64> fwd_max_id = nvl::None;
-    nvl::Maybe<U64> bwd_min_id = nvl::None;
-    auto file = list.end();
-    --file;
-    auto free = list.begin();
-    bool done = false;
-    while (!done) {
-        // Move to next free location
-        while ((!free->is_free() || free->size() == 0) && free != list.end()) {
-            fwd_max_id = nvl::max(fwd_max_id, free->id);
-            ++free;
+/// Offsets of free spans, bucketed by span size. Each bucket is a min-heap, so the leftmost span of each size is
+/// always at the top.
+class FreeSpans {
+public:
+    static constexpr U64 kMaxSize = 9;
+
+    /// Removes and returns the leftmost free span before `limit` which can hold `size` blocks, if one exists.
+    pure nvl::Maybe<Span> take(const U64 size, const U64 limit) {
+        U64 best = 0;
+        for (U64 k = std::max<U64>(size, 1); k <= kMaxSize; ++k) {
+            if (!heaps_[k].empty() && heaps_[k].top() < limit && (best == 0 || heaps_[k].top() < heaps_[best].top())) {
+                best = k;
+            }
         }
-        while ((file->is_free() || file->size() == 0) && file != list.end()) { --file; }
-        bwd_min_id = nvl::min(bwd_min_id, file->id);
-        done = fwd_max_id && bwd_min_id && *fwd_max_id >= *bwd_min_id;
-        if (!done) {
-            const U64 move = std::min(free->size(), file->size());
-            list.emplace(free, file->id, free->begin, free->begin + move);
-            file->end -= move;
-            free->begin += move;
-            Block new_free(nvl::None, file->end, file->end + move);
-            ++file;
-            list.insert(file, new_free);
-            --file;
+        return_if(best == 0, nvl::None);
+        const Span span{heaps_[best].top(), best};
+        heaps_[best].pop();
+        return span;
+    }
+
+    void push(const Span &span) {
+        if (span.size > 0) {
+            heaps_[span.size].push(span.begin);
         }
     }
-    return list;
-}
 
-std::list<Block> do_part2(std::list<Block> list) {
-    auto file = list.end();
-    --file;
-    while (file != list.begin()) {
-        if (file->is_file()) {
-            auto free = list.begin();
-            while (free != file) {
-                if (free->is_free() && free->size() >= file->size()) {
-                    list.emplace(free, file->id, free->begin, free->begin + file->size());
-                    free->begin += file->size();
-                    file->id = nvl::None;
-                    break;
-                }
-                ++free;
-            }
+private:
+    using Heap = std::priority_queue<U64, std::vector<U64>, std::greater<>>;
+    std::array<Heap, kMaxSize + 1> heaps_;
+};
+
+/// Moves each file, from the last to the first, to the first free span to its left that can hold it.
+/// Files are visited by walking the disk map backwards from its end, so only the free spans are held in memory.
+U64 part2(const DiskMap &disk) {
+    FreeSpans frees;
+    U64 offset = 0;
+    for (U64 i = 0; i < disk.files(); ++i) {
+        offset += disk.file(i);
+        frees.push({offset, disk.free(i)});
+        offset += disk.free(i);
+    }
+    U64 checksum = 0;
+    for (U64 id = disk.files(); id-- > 0;) {
+        offset -= disk.free(id) + disk.file(id);
+        Span file{offset, disk.file(id)};
+        if (const auto free = frees.take(file.size, file.begin)) {
+            file.begin = free->begin;
+            frees.push({free->begin + file.size, free->size - file.size});
         }
-        --file;
+        checksum += file.checksum(id);
     }
-    return list;
+    return checksum;
 }
 
 int main() {
-    std::ifstream file ("../data/full/09");
-    std::string line;
-    std::getline(file, line);
-    std::list<Block> list;
-    U64 offset = 0;
-    U64 id = 0;
-    bool is_file = true;
-    for (const char c : line) {
-        const U64 x = static_cast<U64>(c - '0');
-        list.emplace_back(nvl::SomeIf(id, is_file), offset, offset + x);
-        offset += x;
-        id += is_file;
-        is_file = !is_file;
-    }
+    const aoc::MappedFile file("../data/full/09");
+    const DiskMap disk(file.view());
     const auto start = nvl::Clock::now();
-    const auto part1 = do_part1(list);
-    const auto part2 = do_part2(list);
+    const U64 checksum1 = part1(disk);
+    const U64 checksum2 = part2(disk);
     const auto end = nvl::Clock::now();
-    std::cout << "Part 1: " << checksum(part1) << std::endl;
-    std::cout << "Part 2: " << checksum(part2) << std::endl;
+    std::cout << "Part 1: " << checksum1 << std::endl;
+    std::cout << "Part 2: " << checksum2 << std::endl;
     std::cout << "Time: " << nvl::Duration(end - start) << std::endl;
 }
@@ -1,88 +1,159 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
 #include <fstream>
+#include <vector>
 
-#include "nvl/data/List.h"
-#include "nvl/data/Map.h"
-#include "nvl/data/Set.h"
 #include "nvl/data/Tensor.h"
 #include "nvl/geo/Tuple.h"
 #include "nvl/time/Clock.h"
 #include "nvl/time/Duration.h"
 
-using nvl::List;
-using nvl::Map;
-using nvl::Set;
 using Matrix = nvl::Tensor<2, char>;
-using Pos = nvl::Pos<2>;
-
-static constexpr Pos kDirections[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
 
 struct Ranking {
-    Ranking &operator+=(const Ranking &rhs) {
-        score += rhs.score;
-        rating += rhs.rating;
-        return *this;
-    }
     U64 score = 0;
     U64 rating = 0;
 };
 
-template <>
-struct std::hash<List<Pos>> {
-    pure U64 operator()(const List<Pos> &list) const noexcept { return nvl::sip_hash(list.range()); }
+/// Row-major copy of the map's heights, with the cells of each height grouped into layers.
+struct Trails {
+    explicit Trails(const Matrix &map)
+        : rows(static_cast<U64>(map.shape()[0])), cols(static_cast<U64>(map.shape()[1])), height(rows * cols, -1) {
+        for (const auto i : map.indices()) {
+            const U64 cell = static_cast<U64>(i[0]) * cols + static_cast<U64>(i[1]);
+            const char c = map[i];
+            if (c >= '0' && c <= '9') {
+                height[cell] = static_cast<int8_t>(c - '0');
+                layers[c - '0'].push_back(cell);
+            }
+        }
+    }
+
+    /// Calls func on each neighbor of cell which is exactly one step higher.
+    template <typename Func>
+    void for_each_uphill(const U64 cell, Func &&func) const {
+        const int8_t next = static_cast<int8_t>(height[cell] + 1);
+        const U64 col = cell % cols;
+        if (cell >= cols && height[cell - cols] == next) func(cell - cols);
+        if (cell + cols < height.size() && height[cell + cols] == next) func(cell + cols);
+        if (col > 0 && height[cell - 1] == next) func(cell - 1);
+        if (col + 1 < cols && height[cell + 1] == next) func(cell + 1);
+    }
+
+    U64 rows;
+    U64 cols;
+    std::vector<int8_t> height;
+    std::array<std::vector<U64>, 10> layers;
 };
 
-Ranking trailhead_ranking(const Matrix &map, const Pos &trailhead) {
-    Set<Pos> ends;
-    Set<List<Pos>> paths;
-    Map<Pos, U64> next_index;
-    List<Pos> path { trailhead };
-    while (!path.empty()) {
-        const Pos &current = path.back();
-        const char height = map[current];
-        U64 &next_i = next_index.get_or_add(current, 0);
-        if (height == '9') {
-            ends.insert(current);
-            paths.insert(path);
-            next_i = 4;
+/// Number of distinct trails from each cell to any 9, summed layer by layer from the peaks down.
+U64 ratings(const Trails &trails) {
+    std::vector<U64> paths(trails.height.size(), 0);
+    for (const U64 cell : trails.layers[9]) {
+        paths[cell] = 1;
+    }
+    for (int h = 8; h >= 0; --h) {
+        for (const U64 cell : trails.layers[h]) {
+            trails.for_each_uphill(cell, [&](const U64 next) { paths[cell] += paths[next]; });
         }
-        if (next_i < 4) {
-            const Pos next = current + kDirections[next_i];
-            const char next_h = static_cast<char>(height + 1);
-            if (map.has(next) && map[next] == next_h) {
-                path.push_back(next);
+    }
+    U64 rating = 0;
+    for (const U64 cell : trails.layers[0]) {
+        rating += paths[cell];
+    }
+    return rating;
+}
+
+/// Peaks reachable from a cell, as a bitmask over the 19x19 window centered on it. A trail climbs at most 9 steps,
+/// so every peak reachable from a cell is within Manhattan distance 9 of it. Bit (di + 9) * 19 + (dj + 9) is set
+/// if the peak at offset (di, dj) from the cell is reachable.
+struct Reach {
+    static constexpr I64 kSide = 19;
+    static constexpr I64 kCenter = 9 * kSide + 9;
+    static constexpr I64 kWords = (kSide * kSide + 63) / 64;
+
+    static Reach peak() {
+        Reach reach;
+        reach.words[kCenter / 64] |= U64{1} << (kCenter % 64);
+        return reach;
+    }
+
+    /// Adds the peaks reachable from a neighbor whose offsets are `shift` bits (di * 19 + dj) away from this cell's.
+    /// The neighbor's peaks are within distance 8 of it, so none of them wrap around an edge of this window.
+    void add(const Reach &next, const I64 shift) {
+        const I64 q = std::abs(shift) / 64;
+        const I64 r = std::abs(shift) % 64;
+        for (I64 i = 0; i < kWords; ++i) {
+            const I64 src = shift > 0 ? i - q : i + q; // Word of next which lands in word i
+            const I64 carry = shift > 0 ? src - 1 : src + 1;
+            U64 word = 0;
+            if (src >= 0 && src < kWords) {
+                word = shift > 0 ? next.words[src] << r : next.words[src] >> r;
             }
-            next_i += 1;
-        } else {
-            next_index.remove(current);
-            path.pop_back();
+            if (r != 0 && carry >= 0 && carry < kWords) {
+                word |= shift > 0 ? next.words[carry] >> (64 - r) : next.words[carry] << (64 - r);
+            }
+            words[i] |= word;
         }
     }
-    return {.score = ends.size(), .rating = paths.size()};
-}
 
-Ranking trailhead_ranking(const Matrix &map, const List<Pos> &trailheads) {
-    Ranking ranking;
-    for (const Pos &trailhead : trailheads) {
-        ranking += trailhead_ranking(map, trailhead);
+    pure U64 count() const {
+        U64 n = 0;
+        for (const U64 word : words) {
+            n += std::popcount(word);
+        }
+        return n;
     }
-    return ranking;
-}
 
-List<Pos> get_trailheads(const Matrix &map) {
-    List<Pos> trailheads;
-    for (const auto i : map.indices()) {
-        if (map[i] == '0') {
-            trailheads.push_back(i);
+    std::array<U64, kWords> words{};
+};
+
+/// Number of distinct 9s reachable from each trailhead. Each cell's reach is the union of its uphill neighbors',
+/// each shifted into this cell's window. Only the reach of the layer above is kept while sweeping down, so the
+/// sweep is linear in the size of the grid.
+U64 scores(const Trails &trails) {
+    // Position of each cell within its layer.
+    std::vector<U32> slot(trails.height.size(), 0);
+    for (const auto &layer : trails.layers) {
+        for (U64 i = 0; i < layer.size(); ++i) {
+            slot[layer[i]] = static_cast<U32>(i);
         }
     }
-    return trailheads;
+    const I64 cols = static_cast<I64>(trails.cols);
+    std::vector<Reach> upper(trails.layers[9].size(), Reach::peak());
+    std::vector<Reach> lower;
+    U64 score = 0;
+    for (int h = 8; h >= 0; --h) {
+        const std::vector<U64> &layer = trails.layers[h];
+        lower.assign(h > 0 ? layer.size() : 0, Reach{});
+        for (U64 i = 0; i < layer.size(); ++i) {
+            Reach reach;
+            trails.for_each_uphill(layer[i], [&](const U64 next) {
+                const I64 d = static_cast<I64>(next) - static_cast<I64>(layer[i]);
+                reach.add(upper[slot[next]], d == cols ? Reach::kSide : d == -cols ? -Reach::kSide : d);
+            });
+            if (h > 0) {
+                lower[i] = reach;
+            } else {
+                score += reach.count();
+            }
+        }
+        std::swap(upper, lower);
+    }
+    return score;
+}
+
+Ranking trailhead_ranking(const Matrix &map) {
+    const Trails trails(map);
+    return {.score = scores(trails), .rating = ratings(trails)};
 }
 
 int main() {
     const Matrix map = nvl::matrix_from_file("../data/full/10");
     const auto start = nvl::Clock::now();
-    const List<Pos> trailheads = get_trailheads(map);
-    const auto [score, rating] = trailhead_ranking(map, trailheads);
+    const auto [score, rating] = trailhead_ranking(map);
     const auto end = nvl::Clock::now();
     std::cout << "Part 1: " << score << std::endl;
     std::cout << "Part 2: " << rating << std::endl;
@@ -1,15 +1,20 @@
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <fstream>
 #include <iostream>
-#include <list>
 #include <regex>
+#include <utility>
+#include <vector>
 
+#include "aoc/Memo.h"
 #include "nvl/data/List.h"
 #include "nvl/data/Map.h"
-#include "nvl/data/SipHash.h"
 #include "nvl/macros/Aliases.h"
+#include "nvl/macros/Pure.h"
+#include "nvl/macros/ReturnIf.h"
 
 using nvl::List;
-using nvl::Map;
 
 List<U64> parse_ints(const std::string &filename) {
     static const std::regex num("([0-9]+)");
@@ -32,81 +37,269 @@ List<U64> parse_ints(const std::string &filename) {
     return ints;
 }
 
-U64 num_digits(const U64 x) { return static_cast<U64>(std::ceil(std::log10(x + 1))); }
+/// Powers of ten which fit in a U64.
+static constexpr auto kPow10 = [] {
+    std::array<U64, 20> pow{};
+    pow[0] = 1;
+    for (U64 i = 1; i < pow.size(); ++i) {
+        pow[i] = pow[i - 1] * 10;
+    }
+    return pow;
+}();
 
-std::pair<U64, U64> split_digits(const U64 num) {
-    const U64 n = num_digits(num);
-    const U64 d = static_cast<U64>(std::pow(10, n/2));
-    const U64 split0 = num / d;
-    const U64 split1 = num % d;
-    return {split0, split1};
+U64 num_digits(const U64 x) {
+    U64 n = 1;
+    while (n < kPow10.size() && x >= kPow10[n]) { n += 1; }
+    return n;
 }
 
-struct Stone {
-    Stone(const U64 v, const U64 t, const U64 n) : v(v), t(t), n(n) {}
-    U64 v;       // Value on stone
-    U64 t;       // Time created
-    U64 n;       // Number of stones finished when created (ignored when hashing)
-    bool visited = false;
-};
+std::pair<U64, U64> split_digits(const U64 num, const U64 n) {
+    const U64 d = kPow10[n / 2];
+    return {num / d, num % d};
+}
 
-struct StoneHash {
-    pure U64 operator()(const Stone &stone) const noexcept { return nvl::sip_hash(std::pair{stone.v, stone.t}); }
-};
+/// Calls func on each value a stone with the given value turns into after one blink.
+template <typename Func>
+void next_values(const U64 value, Func &&func) {
+    const U64 n = num_digits(value);
+    if (value == 0) {
+        func(1);
+    } else if (n % 2 == 0) {
+        const auto [l, r] = split_digits(value, n);
+        func(l);
+        func(r);
+    } else {
+        func(value * 2024);
+    }
+}
+
+/// Number of stones with each value.
+using Histogram = aoc::Memo<U64, U64>;
+
+/// Steps every distinct stone value once per blink, carrying the number of stones with each value.
+/// Counts wrap modulo 2^64 once the number of stones no longer fits.
+class Blinker {
+public:
+    explicit Blinker(const List<U64> &stones) {
+        for (const U64 stone : stones) {
+            current_.get_or_add(stone) += 1;
+        }
+        totals_.push_back(stones.size());
+    }
+
+    void blink() {
+        U64 total = 0;
+        next_.clear();
+        current_.for_each([&](const U64 value, const U64 count) {
+            next_values(value, [&](const U64 next) {
+                next_.get_or_add(next) += count;
+                total += count;
+            });
+        });
+        std::swap(current_, next_);
+        totals_.push_back(total);
+    }
 
-struct StoneEq {
-    pure bool operator()(const Stone &a, const Stone &b) const noexcept { return a.v == b.v && a.t == b.t; }
+    /// Number of stones after each blink so far, starting with the initial stones.
+    pure const List<U64> &totals() const { return totals_; }
+
+    /// Number of stones after N blinks.
+    pure U64 total(const U64 N) {
+        while (totals_.size() <= N) { blink(); }
+        return totals_[N];
+    }
+
+private:
+    Histogram current_;
+    Histogram next_;
+    List<U64> totals_;
 };
 
-using Cache = Map<Stone,U64,StoneHash,StoneEq>;
-
-U64 blinks(Cache &cache, const U64 stone, const U64 N) {
-    U64 n = 0;
-    List<Stone> stones;
-    stones.emplace_back(/*v*/stone, /*t*/0, n);
-    while (!stones.empty()) {
-        Stone &curr = stones.back();
-        if (auto iter = cache.find(curr); iter != cache.end()) {
-            n += iter->second;
-            stones.pop_back();
-        } else if (curr.t >= N || curr.visited) {
-            if (!curr.visited) {
-                curr.n = n;
-                n += 1;
+/// Stone counts modulo a prime, for blink counts far too large to step one at a time.
+namespace mod {
+
+static constexpr U64 kPrime = 1'000'000'007;
+static constexpr U64 kPrime2 = kPrime * kPrime; // Bound for sums of products, which are kept below 2 * kPrime2
+
+pure U64 pow(U64 x, U64 e) {
+    U64 result = 1;
+    for (; e > 0; e >>= 1, x = x * x % kPrime) {
+        if (e & 1) { result = result * x % kPrime; }
+    }
+    return result;
+}
+
+/// Adds a product of two reduced values to an unreduced sum, keeping the sum below 2 * kPrime2 so it never wraps.
+void mul_add(U64 &sum, const U64 a, const U64 b) {
+    sum += a * b;
+    sum = sum >= kPrime2 ? sum - kPrime2 : sum;
+}
+
+/// Closed set of values reachable from the initial stones, with the sparse transition matrix between them stored
+/// as each value's list of predecessors (one entry per stone produced).
+class Transitions {
+public:
+    explicit Transitions(const List<U64> &stones) {
+        for (const U64 stone : stones) { index(stone); }
+        List<std::pair<U64, U64>> edges;
+        for (U64 i = 0; i < values_.size(); ++i) {
+            next_values(values_[i], [&](const U64 next) { edges.emplace_back(index(next), i); });
+        }
+        std::ranges::sort(edges);
+        first_.resize(values_.size() + 1, 0);
+        for (const auto &[to, from] : edges) {
+            first_[to + 1] += 1;
+            from_.push_back(from);
+        }
+        for (U64 i = 0; i < values_.size(); ++i) {
+            first_[i + 1] += first_[i];
+        }
+        counts_.resize(values_.size(), 0);
+        for (const U64 stone : stones) {
+            counts_[index(stone)] += 1;
+        }
+    }
+
+    pure U64 size() const { return values_.size(); }
+
+    /// Total number of stones after each of the first N blinks, as out[j] = sum of in[i] over predecessors i of j.
+    pure List<U64> totals(const U64 N) const {
+        List<U64> totals;
+        List<U64> current = counts_;
+        List<U64> next(current.size());
+        for (U64 t = 0; t < N; ++t) {
+            U64 total = 0;
+            for (U64 j = 0; j < current.size(); ++j) {
+                U64 sum = 0;
+                for (U64 e = first_[j]; e < first_[j + 1]; ++e) { sum += current[from_[e]]; }
+                next[j] = sum % kPrime;
             }
-            cache[curr] = n - curr.n; // Number finished to the right since this was created
-            stones.pop_back();
-        } else if (curr.v == 0) {
-            curr.visited = true;
-            curr.n = n;
-            stones.emplace_back(1, curr.t + 1, n);
-        } else if (num_digits(curr.v) % 2 == 0) {
-            curr.visited = true;
-            curr.n = n;
-            const U64 t = curr.t;
-            const auto [l, r] = split_digits(curr.v);
-            stones.emplace_back(/*v*/l, t + 1, n + 1); // Don't count to the right
-            stones.emplace_back(/*v*/r, t + 1, n);
+            for (const U64 count : current) { total += count; }
+            totals.push_back(total % kPrime);
+            std::swap(current, next);
+        }
+        return totals;
+    }
+
+private:
+    U64 index(const U64 value) {
+        const U64 i = index_.get_or_add(value, values_.size());
+        if (i == values_.size()) { values_.push_back(value); }
+        return i;
+    }
+
+    List<U64> values_;
+    nvl::Map<U64, U64> index_;
+    List<U64> first_; // from_[first_[j]:first_[j+1]] are the predecessors of value j
+    List<U64> from_;
+    List<U64> counts_;
+};
+
+/// Shortest linear recurrence satisfied by the sequence (Berlekamp-Massey). Returns c with c[0] = 1 such that
+/// sum c[i] * seq[n - i] = 0 for every n >= c.size() - 1.
+pure List<U64> recurrence(const List<U64> &seq) {
+    List<U64> c(seq.size() + 1, 0);
+    List<U64> b(seq.size() + 1, 0);
+    c[0] = b[0] = 1;
+    U64 length = 0;  // Length of the current recurrence c
+    U64 shift = 0;   // Terms since b was last replaced
+    U64 b_delta = 1; // Discrepancy when b was last replaced
+    for (U64 n = 0; n < seq.size(); ++n) {
+        shift += 1;
+        U64 delta = 0;
+        for (U64 i = 0; i <= length; ++i) { mul_add(delta, c[i], seq[n - i]); }
+        delta %= kPrime;
+        if (delta == 0) continue;
+        const List<U64> prev = c;
+        const U64 scale = delta * pow(b_delta, kPrime - 2) % kPrime;
+        for (U64 i = shift; i < c.size(); ++i) {
+            c[i] = (c[i] + kPrime - scale * b[i - shift] % kPrime) % kPrime;
+        }
+        if (2 * length > n) continue;
+        length = n + 1 - length;
+        b = prev;
+        b_delta = delta;
+        shift = 0;
+    }
+    c.resize(length + 1);
+    return c;
+}
+
+/// Term N of a sequence satisfying the recurrence c, from its first c.size() - 1 terms. Computes x^N modulo the
+/// characteristic polynomial by repeated squaring, then takes the same combination of the initial terms.
+pure U64 nth(const List<U64> &seq, const List<U64> &c, const U64 N) {
+    return_if(N < seq.size(), seq[N]);
+    const U64 L = c.size() - 1;
+    return_if(L == 0, 0);
+    // x^L = sum rec[i] * x^(L - i)
+    List<U64> rec(L + 1, 0);
+    for (U64 i = 1; i <= L; ++i) { rec[i] = (kPrime - c[i]) % kPrime; }
+
+    // Reduces a polynomial in place from degree < 2L to degree < L.
+    const auto reduce = [&](List<U64> &poly) {
+        for (U64 k = poly.size(); k-- > L;) {
+            const U64 q = poly[k] % kPrime;
+            if (q == 0) continue;
+            U64 *low = poly.data() + k - L;
+            for (U64 i = 1; i <= L; ++i) { mul_add(low[L - i], q, rec[i]); }
+        }
+        poly.resize(L);
+        for (U64 &x : poly) { x %= kPrime; }
+    };
+
+    List<U64> poly {1};
+    List<U64> square;
+    for (int bit = std::bit_width(N) - 1; bit >= 0; --bit) {
+        square.assign(2 * poly.size() - 1, 0);
+        for (U64 i = 0; i < poly.size(); ++i) {
+            U64 *row = square.data() + i;
+            for (U64 j = 0; j < poly.size(); ++j) { mul_add(row[j], poly[i], poly[j]); }
+        }
+        if ((N >> bit) & 1) { square.insert(square.begin(), 0); } // Multiply by x
+        if (square.size() > L) {
+            reduce(square);
         } else {
-            curr.visited = true;
-            curr.n = n;
-            stones.emplace_back(curr.v * 2024, curr.t + 1, n);
+            for (U64 &x : square) { x %= kPrime; }
         }
+        std::swap(poly, square);
     }
-    return n;
+    U64 result = 0;
+    for (U64 i = 0; i < poly.size(); ++i) { mul_add(result, poly[i], seq[i]); }
+    return result % kPrime;
 }
 
-U64 blinks(const List<U64> &stones, const U64 N) {
-    Cache cache;
-    U64 n = 0;
-    for (const U64 stone : stones) {
-        n += blinks(cache, stone, N);
+/// Number of stones after each of the given blink counts, modulo kPrime.
+pure List<U64> blinks(const List<U64> &stones, const List<U64> &counts) {
+    const Transitions transitions(stones);
+    // The sequence of totals satisfies a recurrence no longer than the number of values, which BM finds from
+    // twice that many terms.
+    const List<U64> seq = transitions.totals(2 * transitions.size() + 2);
+    const List<U64> c = recurrence(seq);
+    List<U64> results;
+    for (const U64 N : counts) {
+        results.push_back(nth(seq, c, N));
     }
-    return n;
+    return results;
 }
 
+} // namespace mod
+
 int main() {
     const List<U64> stones = parse_ints("../data/full/11");
-    std::cout << "Part 1: " << blinks(stones, 25) << std::endl;
-    std::cout << "Part 2: " << blinks(stones, 75) << std::endl;
+    Blinker blinker(stones);
+    std::cout << "Part 1: " << blinker.total(25) << std::endl;
+    std::cout << "Part 2: " << blinker.total(75) << std::endl;
+
+    std::ifstream file("../data/full/11-blinks");
+    List<U64> counts;
+    U64 count;
+    while (file >> count) {
+        counts.push_back(count);
+    }
+    if (!counts.empty()) {
+        const List<U64> results = mod::blinks(stones, counts);
+        for (U64 i = 0; i < counts.size(); ++i) {
+            std::cout << "Blinks " << counts[i] << ": " << results[i] << " (mod " << mod::kPrime << ")" << std::endl;
+        }
+    }
 }
@@ -1,56 +1,162 @@
 #include <fstream>
+#include <utility>
+#include <vector>
 
-#include "nvl/data/Map.h"
 #include "nvl/data/Tensor.h"
-#include "nvl/entity/Block.h"
-#include "nvl/geo/Volume.h"
+#include "nvl/geo/Tuple.h"
 #include "nvl/macros/Aliases.h"
+#include "nvl/macros/Pure.h"
 #include "nvl/time/Clock.h"
 #include "nvl/time/Duration.h"
 
-using namespace nvl;
+using Matrix = nvl::Tensor<2, char>;
+using Pos = nvl::Pos<2>;
 
-template <>
-struct std::hash<Face> {
-    pure U64 operator()(const Face &face) const noexcept { return sip_hash(face); }
+struct Region {
+    Region &operator+=(const Region &rhs) {
+        area += rhs.area;
+        perimeter += rhs.perimeter;
+        sides += rhs.sides;
+        return *this;
+    }
+    U64 area = 0;
+    U64 perimeter = 0;
+    U64 sides = 0; // Equal to the number of corners
 };
 
-pure U64 num_sides(const Range<Ref<Edge<2,I64>>> &edges) {
-    U64 sides = 0;
-    Map<Face, RTree<2,Edge<2,I64>>> faces;
-    // Hash by which face (direction)
-    for (const auto &edge : edges) {
-        faces[edge->face()].insert(edge);
-    }
-    // Find connected components within each of those
-    for (const auto &tree : faces.values()) {
-        sides += tree.components().size();
+struct Price {
+    Price &operator+=(const Region &region) {
+        part1 += region.area * region.perimeter;
+        part2 += region.area * region.sides;
+        return *this;
     }
-    return sides;
+    U64 part1 = 0;
+    U64 part2 = 0;
+};
+
+/// Contribution of a single plot to its region: its own area, the edges it shares with other regions, and the
+/// corners of its region found in the 2x2 windows around it.
+pure Region plot(const Matrix &map, const Pos &pos) {
+    const char c = map[pos];
+    const auto same = [&](const I64 di, const I64 dj) { return map.get_or(pos + Pos(di, dj), '\0') == c; };
+    const bool up = same(-1, 0);
+    const bool down = same(1, 0);
+    const bool left = same(0, -1);
+    const bool right = same(0, 1);
+    Region region{.area = 1, .perimeter = 0, .sides = 0};
+    region.perimeter = !up + !down + !left + !right;
+    // A window has a convex corner if both sides are outside the region, and a concave one if both sides are
+    // inside it but the diagonal is not.
+    const auto corner = [&](const bool a, const bool b, const I64 di, const I64 dj) {
+        return (!a && !b) || (a && b && !same(di, dj));
+    };
+    region.sides = corner(up, left, -1, -1) + corner(up, right, -1, 1) + corner(down, left, 1, -1) +
+                   corner(down, right, 1, 1);
+    return region;
 }
 
-int main() {
-    const auto map = matrix_from_file("../data/full/12");
-    const auto start = Clock::now();
-    Map<char, RTree<2,Box<2>>> plots;
-    for (const auto i : map.indices()) {
-        auto &list = plots[map[i]];
-        list.emplace(i, i + 1);
+/// Union-find over the labels of regions touching the last row, with each root holding its region's totals.
+class Labels {
+public:
+    U64 add() {
+        parent_.push_back(parent_.size());
+        regions_.emplace_back();
+        return parent_.size() - 1;
     }
-    U64 part1 = 0;
-    U64 part2 = 0;
-    for (const auto &tree : plots.values()) {
-        for (const auto &component : tree.components()) {
-            const BRTree<2,Box<2>> edges (component.values());
-            const U64 area = component.size();
-            const U64 perimeter = edges.edges().size();
-            const U64 sides = num_sides(edges.relative.edges());
-            part1 += area * perimeter;
-            part2 += area * sides;
+
+    U64 find(U64 x) {
+        while (parent_[x] != x) {
+            parent_[x] = parent_[parent_[x]];
+            x = parent_[x];
+        }
+        return x;
+    }
+
+    void merge(U64 a, U64 b) {
+        a = find(a);
+        b = find(b);
+        if (a != b) {
+            parent_[b] = a;
+            regions_[a] += regions_[b];
+        }
+    }
+
+    Region &operator[](const U64 x) { return regions_[find(x)]; }
+
+    pure bool is_root(const U64 x) const { return parent_[x] == x; }
+    pure U64 size() const { return parent_.size(); }
+
+    void clear() {
+        parent_.clear();
+        regions_.clear();
+    }
+
+private:
+    std::vector<U64> parent_;
+    std::vector<Region> regions_;
+};
+
+/// Labels regions one row at a time, joining each plot to matching plots to its left and above. After each row,
+/// regions which don't reach that row are complete and are priced, and the rest are relabeled compactly so memory
+/// stays proportional to the width of the map.
+Price price(const Matrix &map) {
+    const I64 rows = map.shape()[0];
+    const I64 cols = map.shape()[1];
+    Price total;
+    Labels labels;
+    Labels next;
+    std::vector<U64> prev_row(cols);
+    std::vector<U64> row(cols);
+    std::vector<U64> remap;
+    static constexpr U64 kNone = static_cast<U64>(-1);
+    for (I64 i = 0; i < rows; ++i) {
+        for (I64 j = 0; j < cols; ++j) {
+            const Pos pos(i, j);
+            const bool left = j > 0 && map[Pos(i, j - 1)] == map[pos];
+            const bool up = i > 0 && map[Pos(i - 1, j)] == map[pos];
+            if (left && up) {
+                row[j] = row[j - 1];
+                labels.merge(row[j], prev_row[j]);
+            } else if (left) {
+                row[j] = row[j - 1];
+            } else if (up) {
+                row[j] = prev_row[j];
+            } else {
+                row[j] = labels.add();
+            }
+            labels[row[j]] += plot(map, pos);
+        }
+        // Carry over regions which reach this row; every other root is a finished region.
+        remap.assign(labels.size(), kNone);
+        next.clear();
+        for (U64 &label : row) {
+            const U64 root = labels.find(label);
+            if (remap[root] == kNone) {
+                remap[root] = next.add();
+                next[remap[root]] = labels[root];
+            }
+            label = remap[root];
         }
+        for (U64 x = 0; x < labels.size(); ++x) {
+            if (labels.is_root(x) && remap[x] == kNone) {
+                total += labels[x];
+            }
+        }
+        std::swap(labels, next);
+        std::swap(prev_row, row);
+    }
+    for (U64 x = 0; x < labels.size(); ++x) {
+        total += labels[x];
     }
-    const auto end = Clock::now();
+    return total;
+}
+
+int main() {
+    const Matrix map = nvl::matrix_from_file("../data/full/12");
+    const auto start = nvl::Clock::now();
+    const auto [part1, part2] = price(map);
+    const auto end = nvl::Clock::now();
     std::cout << "Part 1: " << part1 << std::endl;
     std::cout << "Part 2: " << part2 << std::endl;
-    std::cout << "Time: " << Duration(end - start) << std::endl;
+    std::cout << "Time: " << nvl::Duration(end - start) << std::endl;
 }
@@ -1,6 +1,7 @@
 #include <fstream>
 #include <regex>
 
+#include "aoc/ResultCache.h"
 #include "nvl/data/Maybe.h"
 #include "nvl/data/Set.h"
 #include "nvl/geo/RTree.h"
@@ -111,14 +112,16 @@ I64 part2(const World &world, const List<Robot> &robots) {
 }
 
 int main() {
-    std::fstream file ("../data/full/14");
+    const std::string filename = "../data/full/14";
+    aoc::ResultCache cache ("14", filename);
+    std::fstream file (filename);
     const World world({101, 103});
     List<Robot> robots;
     while (auto robot = Robot::parse(file)) {
         robots.push_back(*robot);
     }
-    std::cout << "Part 1: " << part1(world, robots) << std::endl;
-    const I64 frame = part2(world, robots);
+    std::cout << "Part 1: " << cache.get(1, [&]{ return part1(world, robots); }) << std::endl;
+    const I64 frame = cache.get(2, [&]{ return part2(world, robots); });
     draw(world, robots, frame);
     std::cout << "Part 2: " << frame << std::endl;
 }
\ No newline at end of file
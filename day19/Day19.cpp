@@ -2,49 +2,28 @@
 #include <regex>
 #include <iostream>
 
+#include "aoc/Memo.h"
 #include "nvl/data/List.h"
-#include "nvl/data/Map.h"
-#include "nvl/data/Set.h"
+#include "nvl/data/Maybe.h"
 #include "nvl/macros/Aliases.h"
+#include "nvl/macros/ReturnIf.h"
 
 using namespace nvl;
 
-struct Match {
-    U64 offset = 0;
-    I64 p = 0;
-};
-
 U64 matches(const std::string &line, const List<std::string> &patterns) {
     if (line.empty())
         return {};
-    Map<U64, U64> start;
-    Map<U64, U64> cache;
-    List<Match> frontier{ {0, -1} };
-    U64 total = 0;
-    while (!frontier.empty()) {
-        auto &[i, p] = frontier.back();
-        if (p == -1 && i < line.size()) {
-            start[i] = total;
-        }
-        p += 1;
-        if (i >= line.size()) {
-            frontier.pop_back();
-            total += 1;
-        } else if (cache.has(i)) {
-            frontier.pop_back();
-            total += cache[i];
-        } else if (p < static_cast<I64>(patterns.size())) {
-            const auto &pattern = patterns[p];
-            const auto slice = std::string_view(line).substr(i, pattern.size());
-            if (slice == pattern) {
-                frontier.push_back({i + pattern.size(), -1});
+    // Number of ways to build the suffix of the line starting at each offset.
+    aoc::Memo<U64, U64> cache;
+    return aoc::recurse(cache, U64(0), [&](const U64 i, List<U64> &next) -> Maybe<U64> {
+        return_if(i >= line.size(), 1);
+        for (const auto &pattern : patterns) {
+            if (std::string_view(line).substr(i, pattern.size()) == pattern) {
+                next.push_back(i + pattern.size());
             }
-        } else {
-            cache[i] = total - start[i];
-            frontier.pop_back();
         }
-    }
-    return total;
+        return None;
+    });
 }
 
 List<std::string> patterns(const std::string &line) {